@@ -29,6 +29,8 @@ void main() {
 
     char charset[] = " .:-;!/>)|&IH%*#"; // Darkness gradient
 
+    char line[72];
+
     for (int y = 0; y < height; y++) {
         int c_im = max_im - y * im_factor;
 
@@ -60,13 +62,11 @@ void main() {
                 z_re = z_re2 - z_im2 + c_re;
             }
 
-            if (is_inside) {
-                putc('#');
-            } else {
-                putc(charset[n]);
-            }
+            line[x] = is_inside ? '#' : charset[n];
         }
-        putc('\r'); putc('\n');
+        // Hand the row to the kernel and start on the next while it is sent
+        line[width] = '\r'; line[width + 1] = '\n';
+        write(line, width + 2);
     }
     
     print("\r\nDone.\r\n");
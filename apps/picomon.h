@@ -10,6 +10,10 @@
 #define ADDR_PRINT 0x1000000C
 #define ADDR_EXEC  0x10000010
 #define ADDR_LS    0x10000014
+#define ADDR_WRITE 0x10000018
+#define ADDR_STREAM_OPEN  0x1000001C
+#define ADDR_STREAM_WRITE 0x10000020
+#define ADDR_STREAM_CLOSE 0x10000024
 
 // --- Helper Macros to Call Raw Addresses ---
 // This casts the address to a function pointer and calls it
@@ -31,6 +35,12 @@ static inline void print(char *s) {
     SYSCALL_VOID_STR(ADDR_PRINT, s);
 }
 
+// Queue a buffer for output and return without waiting for the UART.
+// Build whole lines and write() them to overlap computing with sending.
+static inline void write(const char *buf, int len) {
+    ((void (*)(const char*, int))(ADDR_WRITE))(buf, len);
+}
+
 static inline void exec(char *filename) {
     SYSCALL_VOID_STR(ADDR_EXEC, filename);
 }
@@ -39,6 +49,21 @@ static inline void ls(void) {
     SYSCALL_VOID_STR(ADDR_LS, "");
 }
 
+// Capture to a contiguous file without FAT updates (see ../stream.h).
+// Each returns 0 on success or a FatFs FRESULT code; 7 (FR_DENIED) means no
+// contiguous run that long on open, or a write past the size given to open.
+static inline int stream_open(const char *path, uint32_t size) {
+    return ((int (*)(const char*, uint32_t))(ADDR_STREAM_OPEN))(path, size);
+}
+
+static inline int stream_write(const void *buf, uint32_t len) {
+    return ((int (*)(const void*, uint32_t))(ADDR_STREAM_WRITE))(buf, len);
+}
+
+static inline int stream_close(void) {
+    return ((int (*)(void))(ADDR_STREAM_CLOSE))();
+}
+
 // Simple Read Line function for games
 static inline void readline(char *buf, int max) {
     int i = 0;
@@ -0,0 +1,39 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <stdint.h>
+
+// Function Pointer Type:
+// Every command function must accept a string argument (char *args)
+// and return nothing (void).
+typedef void (*cmd_func_t)(char *args);
+
+// The Command Structure
+typedef struct {
+    const char *name;       // The command string (e.g., "peek")
+    cmd_func_t  func;       // The function to call
+    const char *help_text;  // Description for the help command
+} Command;
+
+// Generated into cmdtab.c by tools/gencmds.py from commands.def
+extern const Command commands[];        // Sorted by name, 0-terminated
+extern const uint32_t cmd_count;
+extern const uint32_t cmd_hash_seed;
+extern const uint32_t cmd_hash_mask;
+extern const uint8_t cmd_hash_slot[];   // Slot -> index + 1, 0 = empty
+
+// Slot of 'name' in cmd_hash_slot. Must match cmd_hash() in tools/gencmds.py.
+static inline uint32_t cmd_hash(const char *name) {
+    uint32_t h = cmd_hash_seed;
+    while (*name) h = ((h << 5) + h) ^ (uint8_t)*name++;
+    return (h ^ (h >> 11)) & cmd_hash_mask;
+}
+
+// Look up a command by its full name: one hash and one compare
+const Command *cmd_find(const char *name);
+
+// Commands whose names start with the first 'len' chars of 'prefix'. They
+// are consecutive in commands[]: returns how many, the first in *first.
+int cmd_prefix(const char *prefix, int len, int *first);
+
+#endif
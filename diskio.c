@@ -1,6 +1,111 @@
+#include <string.h>
 #include "ff.h"
 #include "diskio.h"
 #include "sd.h"
+#include "soc.h"
+
+// SECTOR CACHE
+// ==========================================
+// N-way set-associative, LRU, write-back. Single-sector traffic (FAT, directory
+// and FSINFO sectors through fs->win) goes through the cache; multi-sector runs
+// are streamed straight to/from the card and only kept coherent with it.
+// Dirty sectors are written back on eviction and on CTRL_SYNC.
+// Data lives in the .kbuf region so it does not eat into the 32KB kernel area.
+
+#ifndef DISK_CACHE_SETS
+#define DISK_CACHE_SETS  16     // Must be a power of two
+#endif
+#ifndef DISK_CACHE_WAYS
+#define DISK_CACHE_WAYS  4
+#endif
+
+typedef struct {
+    LBA_t    sector;
+    uint32_t last_use;  // LRU stamp (cache_tick at last access)
+    uint8_t  valid;
+    uint8_t  dirty;
+} CacheTag;
+
+// Tags start out undefined too: disk_initialize() clears them, and FatFs
+// reaches the cache only after that.
+static CacheTag cache_tag[DISK_CACHE_SETS][DISK_CACHE_WAYS] KBUF;
+static BYTE cache_data[DISK_CACHE_SETS][DISK_CACHE_WAYS][512] KBUF;
+static uint32_t cache_tick;
+
+DiskCacheStats disk_cache_stats = { .sets = DISK_CACHE_SETS, .ways = DISK_CACHE_WAYS };
+
+static CacheTag *cache_find(LBA_t sector, BYTE **data) {
+    uint32_t set = sector & (DISK_CACHE_SETS - 1);
+    for (int w = 0; w < DISK_CACHE_WAYS; w++) {
+        CacheTag *t = &cache_tag[set][w];
+        if (t->valid && t->sector == sector) {
+            t->last_use = ++cache_tick;
+            *data = cache_data[set][w];
+            return t;
+        }
+    }
+    return 0;
+}
+
+// Pick a free or least recently used way for 'sector', writing it back first
+// if it is dirty. Returns 0 if the write-back failed.
+static CacheTag *cache_victim(LBA_t sector, BYTE **data) {
+    uint32_t set = sector & (DISK_CACHE_SETS - 1);
+    int victim = 0;
+    for (int w = 0; w < DISK_CACHE_WAYS; w++) {
+        if (!cache_tag[set][w].valid) { victim = w; break; }
+        if (cache_tag[set][w].last_use < cache_tag[set][victim].last_use) victim = w;
+    }
+
+    CacheTag *t = &cache_tag[set][victim];
+    if (t->valid && t->dirty) {
+        if (sd_writeblock(t->sector, cache_data[set][victim]) != 0) return 0;
+        STAT(disk_cache_stats.writebacks++);
+    }
+    t->sector = sector;
+    t->valid = 1;
+    t->dirty = 0;
+    t->last_use = ++cache_tick;
+    *data = cache_data[set][victim];
+    return t;
+}
+
+static int cache_flush(void) {
+    int err = 0;
+    for (int s = 0; s < DISK_CACHE_SETS; s++) {
+        for (int w = 0; w < DISK_CACHE_WAYS; w++) {
+            CacheTag *t = &cache_tag[s][w];
+            if (!t->valid || !t->dirty) continue;
+            if (sd_writeblock(t->sector, cache_data[s][w]) != 0) {
+                err = -1;
+                continue;
+            }
+            t->dirty = 0;
+            STAT(disk_cache_stats.writebacks++);
+        }
+    }
+    return err;
+}
+
+static void cache_invalidate(void) {
+    memset(cache_tag, 0, sizeof(cache_tag));
+    cache_tick = 0;
+}
+
+void disk_cache_reset_stats(void) {
+    memset(&disk_cache_stats, 0, sizeof(disk_cache_stats));
+    disk_cache_stats.sets = DISK_CACHE_SETS;
+    disk_cache_stats.ways = DISK_CACHE_WAYS;
+}
+
+DiskIoStats disk_io_stats;
+
+void disk_io_reset_stats(void) {
+    memset(&disk_io_stats, 0, sizeof(disk_io_stats));
+}
+
+// DISKIO INTERFACE
+// ==========================================
 
 // Check Status (Always OK for now)
 DSTATUS disk_status(BYTE pdrv) {
@@ -8,34 +113,120 @@ DSTATUS disk_status(BYTE pdrv) {
 }
 
 // Initialize Disk
+// CID of the card the cache belongs to, from the last good disk_initialize().
+// Kept apart from sd_cid, which any direct sd_init() (sd, dump -s) overwrites.
+static uint8_t cache_cid[16];
+
 DSTATUS disk_initialize(BYTE pdrv) {
-    if (sd_init() == 0) return 0;
+    static const uint8_t no_cid[16];
+
+    int res = sd_init();
+    // Pending writes go back only if the same card answers again (same CID);
+    // after a swap they belong to the old card and are dropped. Then start cold.
+    if (res == 0 && memcmp(cache_cid, sd_cid, sizeof(cache_cid)) == 0 &&
+        memcmp(cache_cid, no_cid, sizeof(cache_cid)) != 0) {
+        cache_flush();
+    }
+    cache_invalidate();
+    if (res == 0) {
+        memcpy(cache_cid, sd_cid, sizeof(cache_cid));
+        return 0;
+    }
+    memset(cache_cid, 0, sizeof(cache_cid));
     return STA_NOINIT;
 }
 
-// Read Sector(s)
-DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count) {
-    // FatFs might ask for multiple sectors, so we loop
-    for (int i = 0; i < count; i++) {
-        if (sd_readblock(sector + i, buff + (i * 512)) != 0) {
+// Read Sector(s) through the cache
+static DRESULT read_sectors(BYTE *buff, LBA_t sector, UINT count) {
+    BYTE *data;
+
+    // Contiguous runs (f_read of whole sectors) go out as one CMD18 stream
+    if (count > 1) {
+        if (sd_readblocks(sector, buff, count) != 0) return RES_ERROR;
+        STAT(disk_cache_stats.bypass += count);
+        // Sectors with unwritten changes in the cache are newer than the card
+        for (UINT i = 0; i < count; i++) {
+            CacheTag *t = cache_find(sector + i, &data);
+            if (t && t->dirty) memcpy(buff + i * 512, data, 512);
+        }
+        return RES_OK;
+    }
+
+    if (cache_find(sector, &data)) {
+        STAT(disk_cache_stats.hits++);
+    } else {
+        STAT(disk_cache_stats.misses++);
+        CacheTag *t = cache_victim(sector, &data);
+        if (!t) return RES_ERROR;
+        if (sd_readblock(sector, data) != 0) {
+            t->valid = 0;
             return RES_ERROR;
         }
     }
+    memcpy(buff, data, 512);
     return RES_OK;
 }
 
-// Write sectors
-DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count) {
-    for (int i = 0; i < count; i++) {
-        if (sd_writeblock(sector + i, buff + (i * 512)) != 0) {
-            return RES_ERROR;
+// Write sectors through the cache
+static DRESULT write_sectors(const BYTE *buff, LBA_t sector, UINT count) {
+    BYTE *data;
+
+    // Contiguous runs (f_write of whole sectors) go out as one CMD25 stream
+    if (count > 1) {
+        if (sd_writeblocks(sector, buff, count) != 0) return RES_ERROR;
+        STAT(disk_cache_stats.bypass += count);
+        // The card now holds the newest copy; drop any cached ones
+        for (UINT i = 0; i < count; i++) {
+            CacheTag *t = cache_find(sector + i, &data);
+            if (t) t->valid = 0;
         }
+        return RES_OK;
+    }
+
+    CacheTag *t = cache_find(sector, &data);
+    if (t) {
+        STAT(disk_cache_stats.hits++);
+    } else {
+        STAT(disk_cache_stats.misses++);
+        t = cache_victim(sector, &data);
+        if (!t) return RES_ERROR;
     }
+    memcpy(data, buff, 512);
+    t->dirty = 1;
     return RES_OK;
 }
 
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count) {
+    STAT(uint32_t t0 = rdcycle());
+    DRESULT res = read_sectors(buff, sector, count);
+    STAT(uint32_t dt = rdcycle() - t0);
+
+    STAT(disk_io_stats.reads++);
+    STAT(disk_io_stats.rd_sectors += count);
+    STAT(disk_io_stats.rd_cycles += dt);
+    STAT(if (dt > disk_io_stats.max_rd_cycles) disk_io_stats.max_rd_cycles = dt);
+    STAT(if (res != RES_OK) disk_io_stats.errors++);
+    return res;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count) {
+    STAT(uint32_t t0 = rdcycle());
+    DRESULT res = write_sectors(buff, sector, count);
+    STAT(uint32_t dt = rdcycle() - t0);
+
+    STAT(disk_io_stats.writes++);
+    STAT(disk_io_stats.wr_sectors += count);
+    STAT(disk_io_stats.wr_cycles += dt);
+    STAT(if (dt > disk_io_stats.max_wr_cycles) disk_io_stats.max_wr_cycles = dt);
+    STAT(if (res != RES_OK) disk_io_stats.errors++);
+    return res;
+}
+
 // IOCTL (Required for some FatFs features, minimal implementation)
 DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff) {
+    if (cmd == CTRL_SYNC) {
+        return cache_flush() == 0 ? RES_OK : RES_ERROR;
+    }
     return RES_OK;
 }
 
@@ -70,6 +70,37 @@ DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
 #define ATA_GET_MODEL		21	/* Get model name */
 #define ATA_GET_SN			22	/* Get serial number */
 
+/* PicoMon sector cache (diskio.c) */
+
+typedef struct {
+	DWORD	hits;		/* Single-sector accesses served from the cache */
+	DWORD	misses;		/* Single-sector accesses that went to the card */
+	DWORD	writebacks;	/* Dirty sectors written back (eviction or CTRL_SYNC) */
+	DWORD	bypass;		/* Sectors streamed past the cache by multi-sector runs */
+	WORD	sets;		/* Geometry: sets x ways x 512 bytes */
+	WORD	ways;
+} DiskCacheStats;
+
+extern DiskCacheStats disk_cache_stats;
+void disk_cache_reset_stats (void);
+
+/* PicoMon disk_read/disk_write counters, as seen by FatFs (cache included) */
+
+typedef struct {
+	DWORD	reads;			/* disk_read calls */
+	DWORD	writes;			/* disk_write calls */
+	DWORD	rd_sectors;		/* Sectors requested */
+	DWORD	wr_sectors;
+	DWORD	errors;			/* Calls that returned RES_ERROR */
+	QWORD	rd_cycles;		/* Total time in disk_read / disk_write */
+	QWORD	wr_cycles;
+	DWORD	max_rd_cycles;	/* Worst single call */
+	DWORD	max_wr_cycles;
+} DiskIoStats;
+
+extern DiskIoStats disk_io_stats;
+void disk_io_reset_stats (void);
+
 #ifdef __cplusplus
 }
 #endif
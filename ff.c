@@ -266,6 +266,31 @@
 #endif
 
 
+/* FAT sector cache */
+#if FF_FAT_CACHE == 1
+#error FF_FAT_CACHE must be 0 or 2 or more
+#endif
+#ifndef FF_FAT_CACHE_ATTR
+#define FF_FAT_CACHE_ATTR
+#endif
+#ifndef FF_FREE_MAP_ATTR
+#define FF_FREE_MAP_ATTR
+#endif
+
+/* Directory name index */
+#if !defined(FF_DIR_INDEX) || FF_USE_LFN
+#define DIR_INDEX	0
+#else
+#define DIR_INDEX	FF_DIR_INDEX
+#endif
+#if DIR_INDEX && (FF_DIR_INDEX_SLOTS & (FF_DIR_INDEX_SLOTS - 1))
+#error FF_DIR_INDEX_SLOTS must be a power of 2
+#endif
+#ifndef FF_DIR_INDEX_ATTR
+#define FF_DIR_INDEX_ATTR
+#endif
+
+
 /* Timestamp */
 #if FF_FS_NORTC == 1
 #if FF_NORTC_YEAR < 1980 || FF_NORTC_YEAR > 2107 || FF_NORTC_MON < 1 || FF_NORTC_MON > 12 || FF_NORTC_MDAY < 1 || FF_NORTC_MDAY > 31
@@ -463,6 +488,25 @@ typedef struct {	/* Open object identifier with status */
 #endif
 static FATFS *FatFs[FF_VOLUMES];	/* Pointer to the filesystem objects (logical drives) */
 static WORD Fsid;					/* Filesystem mount ID */
+#if FF_FAT_CACHE
+static BYTE FatCacheBuf[FF_VOLUMES][FF_FAT_CACHE][FF_MAX_SS] FF_FAT_CACHE_ATTR;	/* FAT cache buffers of each volume */
+#endif
+#if FF_FREE_MAP && !FF_FS_READONLY
+static DWORD FreeMap[FF_VOLUMES][FF_FREE_MAP_BYTES / 4] FF_FREE_MAP_ATTR;	/* Free cluster map of each volume */
+#endif
+#if DIR_INDEX
+typedef struct {
+	FATFS*	fs;			/* Filesystem object of the directory (stat 0:unused) */
+	WORD	id;			/* Volume mount ID when the index was built */
+	BYTE	stat;		/* 0:Unused, 1:Valid, 2:Too many entries to index */
+	DWORD	sclust;		/* Start cluster of the directory (0:root directory) */
+	DWORD	tick;		/* Last use, for LRU replacement */
+	UINT	nent;		/* Number of entries in the table */
+} DIRIDX;
+static DIRIDX DirIdx[DIR_INDEX];		/* Indexed directories */
+static DWORD DirIdxTbl[DIR_INDEX][FF_DIR_INDEX_SLOTS] FF_DIR_INDEX_ATTR;	/* Hash tables, hash tag | entry number, or 0xFFFFFFFF */
+static DWORD DirIdxTick;
+#endif
 
 #if FF_FS_RPATH
 static BYTE CurrVol;				/* Current drive number set by f_chdrive() */
@@ -1064,6 +1108,7 @@ static FRESULT sync_window (	/* Returns FR_OK or FR_DISK_ERR */
 	if (fs->wflag) {	/* Is the disk access window dirty? */
 		if (disk_write(fs->pdrv, fs->win, fs->winsect, 1) == RES_OK) {	/* Write it back into the volume */
 			fs->wflag = 0;	/* Clear window dirty flag */
+			fs->wcnt++;
 			if (fs->winsect - fs->fatbase < fs->fsize) {	/* Is it in the 1st FAT? */
 				if (fs->n_fats == 2) disk_write(fs->pdrv, fs->win, fs->winsect + fs->fsize, 1);	/* Reflect it to 2nd FAT if needed */
 			}
@@ -1102,6 +1147,287 @@ static FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERR */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* FAT sector cache                                                      */
+/*-----------------------------------------------------------------------*/
+/* get_fat(), put_fat() and the FAT scan of f_getfree() reach the FAT through
+/  fat_sector(). With FF_FAT_CACHE, FAT sectors live in a small LRU cache of
+/  their own, so a chain walk does not push the directory sector out of the
+/  win[] and a FAT sector is read from the disk once while it stays in use.
+/  Changed sectors are written back to every FAT copy on eviction and in
+/  sync_fs(). Without it, the FAT goes through the win[] as before. */
+
+#if FF_FAT_CACHE
+static void clear_fat_cache (
+	FATFS* fs		/* Filesystem object */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < FF_FAT_CACHE; i++) {
+		fs->fcsect[i] = (LBA_t)0 - 1;
+		fs->fcuse[i] = 0;
+		fs->fcflag[i] = 0;
+	}
+	fs->fctick = 0;
+	fs->fclast = 0;
+}
+
+
+#if !FF_FS_READONLY
+static FRESULT write_fat_sector (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs,		/* Filesystem object */
+	UINT i			/* Dirty cache slot to write back */
+)
+{
+	LBA_t sect = fs->fcsect[i];
+
+
+	if (disk_write(fs->pdrv, fs->fcbuf[i], sect, 1) != RES_OK) return FR_DISK_ERR;
+	if (fs->n_fats == 2) disk_write(fs->pdrv, fs->fcbuf[i], sect + fs->fsize, 1);	/* Reflect it to 2nd FAT */
+	fs->fcflag[i] = 0;
+	if (fs->winsect == sect && !fs->wflag) fs->winsect = (LBA_t)0 - 1;	/* A copy in the win[] is out of date now */
+	return FR_OK;
+}
+
+
+static FRESULT sync_fat (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs		/* Filesystem object */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < FF_FAT_CACHE; i++) {
+		if (fs->fcflag[i] && write_fat_sector(fs, i) != FR_OK) return FR_DISK_ERR;
+	}
+	return FR_OK;
+}
+#endif
+#endif
+
+
+static BYTE* fat_sector (	/* Returns pointer to the sector data, NULL:Disk error */
+	FATFS* fs,		/* Filesystem object */
+	LBA_t sect		/* FAT sector to access */
+)
+{
+#if FF_FAT_CACHE
+	UINT i, v = 0;
+
+
+	for (i = 0; i < FF_FAT_CACHE; i++) {	/* Find the sector in the cache, and the least recently used slot */
+		if (fs->fcsect[i] == sect) {
+			fs->fcuse[i] = ++fs->fctick;
+			fs->fclast = i;
+			return fs->fcbuf[i];
+		}
+		if (fs->fcuse[i] < fs->fcuse[v]) v = i;
+	}
+#if !FF_FS_READONLY
+	if (fs->fcflag[v] && write_fat_sector(fs, v) != FR_OK) return 0;	/* Evict the slot */
+#endif
+	if (fs->winsect == sect) {	/* Take it from the win[] if it happens to be there */
+		memcpy(fs->fcbuf[v], fs->win, SS(fs));
+	} else if (disk_read(fs->pdrv, fs->fcbuf[v], sect, 1) != RES_OK) {
+		fs->fcsect[v] = (LBA_t)0 - 1;
+		fs->fcuse[v] = 0;
+		return 0;
+	}
+	fs->fcsect[v] = sect;
+	fs->fcuse[v] = ++fs->fctick;
+	fs->fclast = v;
+	return fs->fcbuf[v];
+#else
+	return move_window(fs, sect) == FR_OK ? fs->win : 0;
+#endif
+}
+
+
+#if !FF_FS_READONLY
+static void mark_fat_dirty (
+	FATFS* fs		/* Filesystem object (the sector last returned by fat_sector() has been changed) */
+)
+{
+#if FF_FAT_CACHE
+	fs->fcflag[fs->fclast] = 1;
+#else
+	fs->wflag = 1;
+#endif
+}
+#endif
+
+
+
+
+#if FF_FREE_MAP && !FF_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* Free cluster map (FAT16/FAT32)                                        */
+/*-----------------------------------------------------------------------*/
+/* fs->fmap has a bit per FAT sector, set while the sector has a free entry.
+/  put_fat() keeps it up to date: freeing an entry sets the bit, and taking
+/  one clears it when no other free entry is left in the sector. The look for
+/  another free entry starts next to the one taken, so it ends at once while
+/  a sector is being filled in order. */
+
+static DWORD fmap_sect (	/* FAT sector index of the entry */
+	FATFS* fs,		/* Filesystem object */
+	DWORD clst		/* Cluster number */
+)
+{
+	return (fs->fs_type == FS_FAT32) ? clst / (SS(fs) / 4) : clst / (SS(fs) / 2);
+}
+
+
+static int fat_ent_free (	/* 1:Entry i in the FAT sector data is free */
+	FATFS* fs,		/* Filesystem object */
+	const BYTE* p,	/* FAT sector data */
+	UINT i			/* Entry index in the sector */
+)
+{
+	return (fs->fs_type == FS_FAT32) ? (ld_32(p + i * 4) & 0x0FFFFFFF) == 0 : ld_16(p + i * 2) == 0;
+}
+
+
+static void free_map_update (
+	FATFS* fs,		/* Filesystem object */
+	const BYTE* p,	/* FAT sector data holding the entry */
+	DWORD clst		/* Cluster whose entry has been changed */
+)
+{
+	DWORD s, bit, c;
+	UINT i, n, ents;
+
+
+	if (fs->fmstat != 1) return;
+	s = fmap_sect(fs, clst);
+	bit = (DWORD)1 << (s % 32);
+	ents = (fs->fs_type == FS_FAT32) ? SS(fs) / 4 : SS(fs) / 2;
+	i = (fs->fs_type == FS_FAT32) ? clst % (SS(fs) / 4) : clst % (SS(fs) / 2);
+	if (fat_ent_free(fs, p, i)) {	/* Freed: the sector has a free entry now */
+		fs->fmap[s / 32] |= bit;
+		return;
+	}
+	if (!(fs->fmap[s / 32] & bit)) return;	/* Already known to be full */
+	for (n = 1; n < ents; n++) {	/* Taken: look for another free entry, starting next to it */
+		if (++i == ents) i = 0;
+		c = s * ents + i;
+		if (c >= 2 && c < fs->n_fatent && fat_ent_free(fs, p, i)) return;
+	}
+	fs->fmap[s / 32] &= ~bit;	/* That was the last one */
+}
+
+
+static FRESULT build_free_map (	/* FR_OK or FR_DISK_ERR */
+	FATFS* fs,		/* Filesystem object (FAT16/FAT32) */
+	DWORD* nfree	/* Returns number of free clusters */
+)
+{
+	DWORD s, nsect, clst, n = 0;
+	UINT i, ents, any;
+	int fit;
+	BYTE *p;
+
+
+	nsect = fmap_sect(fs, fs->n_fatent - 1) + 1;
+	ents = (fs->fs_type == FS_FAT32) ? SS(fs) / 4 : SS(fs) / 2;
+	fit = (nsect <= (DWORD)FF_FREE_MAP_BYTES * 8);	/* The volume is counted anyway, but mapped only if it fits */
+	fs->fmstat = 2;
+	if (fit) memset(fs->fmap, 0, FF_FREE_MAP_BYTES);
+	clst = 0;
+	for (s = 0; s < nsect; s++) {
+		if (!(p = fat_sector(fs, fs->fatbase + s))) return FR_DISK_ERR;
+		any = 0;
+		for (i = 0; i < ents && clst < fs->n_fatent; i++, clst++) {
+			if (clst >= 2 && fat_ent_free(fs, p, i)) {
+				n++; any = 1;
+			}
+		}
+		if (fit && any) fs->fmap[s / 32] |= (DWORD)1 << (s % 32);
+	}
+	if (fit) fs->fmstat = 1;
+	*nfree = n;
+	return FR_OK;
+}
+
+
+static DWORD next_map_bit (	/* First set bit in the range, or 'to' if none */
+	FATFS* fs,		/* Filesystem object */
+	DWORD from,		/* Start of the range */
+	DWORD to		/* End of the range (not included) */
+)
+{
+	DWORD w;
+
+
+	while (from < to) {
+		w = fs->fmap[from / 32] >> (from % 32);
+		if (w) {	/* A set bit in this word */
+			while (!(w & 1)) {
+				w >>= 1; from++;
+			}
+			return from < to ? from : to;
+		}
+		from = (from | 31) + 1;	/* Skip to the next word */
+	}
+	return to;
+}
+
+
+static DWORD scan_fat_sector (	/* 0:No free entry, 0xFFFFFFFF:Disk error, >=2:Free cluster# */
+	FATFS* fs,		/* Filesystem object */
+	DWORD s,		/* FAT sector index */
+	UINT i			/* Entry index to start at */
+)
+{
+	UINT ents = (fs->fs_type == FS_FAT32) ? SS(fs) / 4 : SS(fs) / 2;
+	DWORD clst = s * ents + i;
+	BYTE *p;
+
+
+	if (!(p = fat_sector(fs, fs->fatbase + s))) return 0xFFFFFFFF;
+	for ( ; i < ents && clst < fs->n_fatent; i++, clst++) {
+		if (clst >= 2 && fat_ent_free(fs, p, i)) return clst;
+	}
+	return 0;
+}
+
+
+static DWORD find_free_cluster (	/* 0:No free cluster, 0xFFFFFFFF:Disk error, >=2:Free cluster# */
+	FATFS* fs,		/* Filesystem object (free cluster map is valid) */
+	DWORD scl		/* Search starts after this cluster */
+)
+{
+	DWORD ncl, s, s0, nsect, from, to;
+	UINT pass;
+
+
+	ncl = scl + 1;
+	if (ncl >= fs->n_fatent) ncl = 2;
+	s0 = fmap_sect(fs, ncl);
+	nsect = fmap_sect(fs, fs->n_fatent - 1) + 1;
+
+	if (fs->fmap[s0 / 32] & ((DWORD)1 << (s0 % 32))) {	/* Rest of the first sector */
+		ncl = scan_fat_sector(fs, s0, ncl - (fs->fs_type == FS_FAT32 ? s0 * (SS(fs) / 4) : s0 * (SS(fs) / 2)));
+		if (ncl != 0) return ncl;
+	}
+	for (pass = 0; pass < 2; pass++) {	/* Sectors after it, then from the top of the FAT back to it */
+		from = pass ? 0 : s0 + 1;
+		to = pass ? s0 + 1 : nsect;
+		for (s = from; (s = next_map_bit(fs, s, to)) < to; s++) {
+			ncl = scan_fat_sector(fs, s, 0);
+			if (ncl != 0) return ncl;
+			fs->fmap[s / 32] &= ~((DWORD)1 << (s % 32));	/* No free entry left in the sector */
+		}
+	}
+	return 0;
+}
+#endif
+
+
+
+
 #if !FF_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* Synchronize filesystem and data on the storage                        */
@@ -1114,7 +1440,12 @@ static FRESULT sync_fs (	/* Returns FR_OK or FR_DISK_ERR */
 	FRESULT res;
 
 
+#if FF_FAT_CACHE
+	res = sync_fat(fs);
+	if (res == FR_OK) res = sync_window(fs);
+#else
 	res = sync_window(fs);
+#endif
 	if (res == FR_OK) {
 		if (fs->fsi_flag == 1) {	/* Allocation changed? */
 			fs->fsi_flag = 0;
@@ -1180,6 +1511,7 @@ static DWORD get_fat (		/* 0xFFFFFFFF:Disk error, 1:Internal error, 2..0x7FFFFFF
 {
 	UINT wc, bc;
 	DWORD val;
+	BYTE *p;
 	FATFS *fs = obj->fs;
 
 
@@ -1192,21 +1524,21 @@ static DWORD get_fat (		/* 0xFFFFFFFF:Disk error, 1:Internal error, 2..0x7FFFFFF
 		switch (fs->fs_type) {
 		case FS_FAT12 :
 			bc = (UINT)clst; bc += bc / 2;
-			if (move_window(fs, fs->fatbase + (bc / SS(fs))) != FR_OK) break;
-			wc = fs->win[bc++ % SS(fs)];		/* Get 1st byte of the entry */
-			if (move_window(fs, fs->fatbase + (bc / SS(fs))) != FR_OK) break;
-			wc |= fs->win[bc % SS(fs)] << 8;	/* Merge 2nd byte of the entry */
+			if (!(p = fat_sector(fs, fs->fatbase + (bc / SS(fs))))) break;
+			wc = p[bc++ % SS(fs)];		/* Get 1st byte of the entry */
+			if (!(p = fat_sector(fs, fs->fatbase + (bc / SS(fs))))) break;
+			wc |= p[bc % SS(fs)] << 8;	/* Merge 2nd byte of the entry */
 			val = (clst & 1) ? (wc >> 4) : (wc & 0xFFF);	/* Adjust bit position */
 			break;
 
 		case FS_FAT16 :
-			if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 2))) != FR_OK) break;
-			val = ld_16(fs->win + clst * 2 % SS(fs));		/* Simple WORD array */
+			if (!(p = fat_sector(fs, fs->fatbase + (clst / (SS(fs) / 2))))) break;
+			val = ld_16(p + clst * 2 % SS(fs));		/* Simple WORD array */
 			break;
 
 		case FS_FAT32 :
-			if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 4))) != FR_OK) break;
-			val = ld_32(fs->win + clst * 4 % SS(fs)) & 0x0FFFFFFF;	/* Simple DWORD array but mask out upper 4 bits */
+			if (!(p = fat_sector(fs, fs->fatbase + (clst / (SS(fs) / 4))))) break;
+			val = ld_32(p + clst * 4 % SS(fs)) & 0x0FFFFFFF;	/* Simple DWORD array but mask out upper 4 bits */
 			break;
 #if FF_FS_EXFAT
 		case FS_EXFAT :
@@ -1226,8 +1558,8 @@ static DWORD get_fat (		/* 0xFFFFFFFF:Disk error, 1:Internal error, 2..0x7FFFFFF
 					if (obj->n_frag != 0) {	/* Is it on the growing edge? */
 						val = 0x7FFFFFFF;	/* Generate EOC */
 					} else {
-						if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 4))) != FR_OK) break;
-						val = ld_32(fs->win + clst * 4 % SS(fs)) & 0x7FFFFFFF;
+						if (!(p = fat_sector(fs, fs->fatbase + (clst / (SS(fs) / 4))))) break;
+						val = ld_32(p + clst * 4 % SS(fs)) & 0x7FFFFFFF;
 					}
 					break;
 				}
@@ -1266,36 +1598,44 @@ static FRESULT put_fat (	/* FR_OK(0):succeeded, !=0:error */
 		switch (fs->fs_type) {
 		case FS_FAT12:
 			bc = (UINT)clst; bc += bc / 2;	/* bc: byte offset of the entry */
-			res = move_window(fs, fs->fatbase + (bc / SS(fs)));
-			if (res != FR_OK) break;
-			p = fs->win + bc++ % SS(fs);
+			res = FR_DISK_ERR;
+			if (!(p = fat_sector(fs, fs->fatbase + (bc / SS(fs))))) break;
+			p += bc++ % SS(fs);
 			*p = (clst & 1) ? ((*p & 0x0F) | ((BYTE)val << 4)) : (BYTE)val;	/* Update 1st byte */
-			fs->wflag = 1;
-			res = move_window(fs, fs->fatbase + (bc / SS(fs)));
-			if (res != FR_OK) break;
-			p = fs->win + bc % SS(fs);
+			mark_fat_dirty(fs);
+			if (!(p = fat_sector(fs, fs->fatbase + (bc / SS(fs))))) break;
+			p += bc % SS(fs);
 			*p = (clst & 1) ? (BYTE)(val >> 4) : ((*p & 0xF0) | ((BYTE)(val >> 8) & 0x0F));	/* Update 2nd byte */
-			fs->wflag = 1;
+			mark_fat_dirty(fs);
+			res = FR_OK;
 			break;
 
 		case FS_FAT16:
-			res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 2)));
-			if (res != FR_OK) break;
-			st_16(fs->win + clst * 2 % SS(fs), (WORD)val);	/* Simple WORD array */
-			fs->wflag = 1;
+			res = FR_DISK_ERR;
+			if (!(p = fat_sector(fs, fs->fatbase + (clst / (SS(fs) / 2))))) break;
+			st_16(p + clst * 2 % SS(fs), (WORD)val);	/* Simple WORD array */
+			mark_fat_dirty(fs);
+#if FF_FREE_MAP
+			free_map_update(fs, p, clst);
+#endif
+			res = FR_OK;
 			break;
 
 		case FS_FAT32:
 #if FF_FS_EXFAT
 		case FS_EXFAT:
 #endif
-			res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 4)));
-			if (res != FR_OK) break;
+			res = FR_DISK_ERR;
+			if (!(p = fat_sector(fs, fs->fatbase + (clst / (SS(fs) / 4))))) break;
 			if (!FF_FS_EXFAT || fs->fs_type != FS_EXFAT) {
-				val = (val & 0x0FFFFFFF) | (ld_32(fs->win + clst * 4 % SS(fs)) & 0xF0000000);
+				val = (val & 0x0FFFFFFF) | (ld_32(p + clst * 4 % SS(fs)) & 0xF0000000);
 			}
-			st_32(fs->win + clst * 4 % SS(fs), val);
-			fs->wflag = 1;
+			st_32(p + clst * 4 % SS(fs), val);
+			mark_fat_dirty(fs);
+#if FF_FREE_MAP
+			if (fs->fs_type == FS_FAT32) free_map_update(fs, p, clst);
+#endif
+			res = FR_OK;
 			break;
 		}
 	}
@@ -1598,6 +1938,22 @@ static DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:D
 				ncl = 0;
 			}
 		}
+#if FF_FREE_MAP
+		if (ncl == 0 && fs->fs_type != FS_FAT12) {	/* Find another fragment with the free cluster map */
+			if (fs->fmstat == 0) {	/* First search since mount: build the map */
+				if (build_free_map(fs, &cs) != FR_OK) return 0xFFFFFFFF;
+				if (cs != fs->free_clst) {
+					fs->free_clst = cs;
+					fs->fsi_flag |= 1;
+				}
+				if (cs == 0) return 0;
+			}
+			if (fs->fmstat == 1) {
+				ncl = find_free_cluster(fs, scl);
+				if (ncl == 0 || ncl == 0xFFFFFFFF) return ncl;
+			}
+		}
+#endif
 		if (ncl == 0) {	/* The new cluster cannot be contiguous and find another fragment */
 			ncl = scl;	/* Start cluster */
 			for (;;) {
@@ -2405,6 +2761,147 @@ static FRESULT dir_read (
 
 
 
+#if DIR_INDEX
+/*-----------------------------------------------------------------------*/
+/* Directory handling - SFN index                                        */
+/*-----------------------------------------------------------------------*/
+/* A table slot holds bits 30-16 of the name hash as a tag and the entry
+/  number (dptr / SZDIRE, up to 65535) in the low 16 bits. Linear probing from
+/  the slot picked by the low hash bits; an empty slot ends the probe. */
+
+#define DIX_EMPTY	0xFFFFFFFF
+#define DIX_TAG		0x7FFF0000
+
+static DWORD sfn_hash (	/* Hash of the 11-byte SFN */
+	const BYTE* sfn
+)
+{
+	DWORD h = 5381;
+	UINT n = 11;
+
+
+	do h = (h << 5) + h + *sfn++; while (--n);	/* h * 33 + c, without a multiplier */
+	return h ^ (h >> 15);
+}
+
+
+static DIRIDX* dir_index (	/* Index of the directory, 0 if none */
+	DIR* dp
+)
+{
+	FATFS *fs = dp->obj.fs;
+	UINT i;
+
+
+	for (i = 0; i < DIR_INDEX; i++) {
+		if (DirIdx[i].stat && DirIdx[i].fs == fs && DirIdx[i].id == fs->id && DirIdx[i].sclust == dp->obj.sclust) {
+			DirIdx[i].tick = ++DirIdxTick;
+			return &DirIdx[i];
+		}
+	}
+	return 0;
+}
+
+
+static void dir_index_drop (	/* Forget the indexes of a volume */
+	FATFS* fs
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < DIR_INDEX; i++) {
+		if (DirIdx[i].fs == fs) DirIdx[i].stat = 0;
+	}
+}
+
+
+static int dir_index_add (	/* 0:Added, 1:Table is full */
+	DIRIDX* ix,
+	const BYTE* sfn,		/* Name in the entry */
+	DWORD dptr				/* Offset of the entry */
+)
+{
+	DWORD *tbl = DirIdxTbl[ix - DirIdx];
+	DWORD h = sfn_hash(sfn);
+	UINT i;
+
+
+	if (ix->nent >= FF_DIR_INDEX_SLOTS / 4 * 3) return 1;	/* Keep probe chains short */
+	for (i = h & (FF_DIR_INDEX_SLOTS - 1); tbl[i] != DIX_EMPTY; i = (i + 1) & (FF_DIR_INDEX_SLOTS - 1)) ;
+	tbl[i] = (h & DIX_TAG) | (dptr / SZDIRE);
+	ix->nent++;
+	return 0;
+}
+
+
+static FRESULT dir_index_build (	/* Read the directory into a new index */
+	DIR* dp,
+	DIRIDX** pix
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	DIRIDX *ix = &DirIdx[0];
+	UINT i;
+
+
+	for (i = 1; i < DIR_INDEX && ix->stat; i++) {	/* An unused index or the least recently used one */
+		if (!DirIdx[i].stat || DirIdx[i].tick < ix->tick) ix = &DirIdx[i];
+	}
+	ix->stat = 0; ix->fs = fs; ix->id = fs->id; ix->sclust = dp->obj.sclust;
+	ix->tick = ++DirIdxTick; ix->nent = 0;
+	memset(DirIdxTbl[ix - DirIdx], 0xFF, sizeof DirIdxTbl[0]);
+
+	res = dir_sdi(dp, 0);
+	while (res == FR_OK) {
+		res = move_window(fs, dp->sect);
+		if (res != FR_OK) break;
+		if (dp->dir[DIR_Name] == 0) break;	/* End of table */
+		if (dp->dir[DIR_Name] != DDEM && !(dp->dir[DIR_Attr] & AM_VOL)) {	/* The entries dir_find() can match */
+			if (dir_index_add(ix, dp->dir, dp->dptr)) {	/* Too large, leave it to the linear search */
+				ix->stat = 2;
+				break;
+			}
+		}
+		res = dir_next(dp, 0);
+	}
+	if (res == FR_NO_FILE) res = FR_OK;		/* End of the directory */
+	if (res == FR_OK && !ix->stat) ix->stat = 1;
+	*pix = ix;
+	return res;
+}
+
+
+static FRESULT dir_index_find (	/* Look up dp->fn in the index, same results as the linear search */
+	DIR* dp,
+	DIRIDX* ix
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	DWORD *tbl = DirIdxTbl[ix - DirIdx];
+	DWORD h = sfn_hash(dp->fn), e;
+	UINT i;
+
+
+	for (i = h & (FF_DIR_INDEX_SLOTS - 1); (e = tbl[i]) != DIX_EMPTY; i = (i + 1) & (FF_DIR_INDEX_SLOTS - 1)) {
+		if ((e & DIX_TAG) != (h & DIX_TAG)) continue;
+		res = dir_sdi(dp, (e & 0xFFFF) * SZDIRE);	/* Check the name in the entry */
+		if (res == FR_OK) res = move_window(fs, dp->sect);
+		if (res != FR_OK) return res;
+		if (!(dp->dir[DIR_Attr] & AM_VOL) && !memcmp(dp->dir, dp->fn, 11)) {
+			dp->obj.attr = dp->dir[DIR_Attr] & AM_MASK;
+			return FR_OK;
+		}
+	}
+	return FR_NO_FILE;
+}
+
+#endif	/* DIR_INDEX */
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Find an object in the directory                  */
 /*-----------------------------------------------------------------------*/
@@ -2445,6 +2942,19 @@ static FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 	/* On the FAT/FAT32 volume */
 #if FF_USE_LFN
 	ord = sum = 0xFF; dp->blk_ofs = 0xFFFFFFFF;	/* Reset LFN sequence */
+#endif
+#if DIR_INDEX
+	{
+		DIRIDX *ix = dir_index(dp);
+
+		if (!ix) {		/* First lookup in this directory */
+			res = dir_index_build(dp, &ix);
+			if (res != FR_OK) return res;
+		}
+		if (ix->stat == 1) return dir_index_find(dp, ix);
+		res = dir_sdi(dp, 0);	/* Not indexed, rewind for the linear search */
+		if (res != FR_OK) return res;
+	}
 #endif
 	do {
 		res = move_window(fs, dp->sect);
@@ -2589,6 +3099,13 @@ static FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too
 			dp->dir[DIR_NTres] = dp->fn[NSFLAG] & (NS_BODY | NS_EXT);	/* Put low-case flags */
 #endif
 			fs->wflag = 1;
+#if DIR_INDEX
+			{
+				DIRIDX *ix = dir_index(dp);
+
+				if (ix && ix->stat == 1 && dir_index_add(ix, dp->fn, dp->dptr)) ix->stat = 2;	/* Keep the index current */
+			}
+#endif
 		}
 	}
 
@@ -2631,6 +3148,9 @@ static FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 	}
 #else			/* Non LFN configuration */
 
+#if DIR_INDEX
+	dir_index_drop(fs);		/* The entry may be an indexed directory, drop them all */
+#endif
 	res = move_window(fs, dp->sect);
 	if (res == FR_OK) {
 		dp->dir[DIR_Name] = DDEM;	/* Mark the entry 'deleted'.*/
@@ -3499,6 +4019,17 @@ static FRESULT mount_volume (	/* FR_OK(0): successful, !=0: an error occurred */
 	/* Following code attempts to mount the volume. (find an FAT volume, analyze the BPB and initialize the filesystem object) */
 
 	fs->fs_type = 0;					/* Invalidate the filesystem object */
+#if FF_FAT_CACHE
+	fs->fcbuf = FatCacheBuf[vol];		/* Start with an empty FAT cache */
+	clear_fat_cache(fs);
+#endif
+#if FF_FREE_MAP && !FF_FS_READONLY
+	fs->fmap = FreeMap[vol];			/* Free cluster map is built on first use */
+	fs->fmstat = 0;
+#endif
+#if DIR_INDEX
+	dir_index_drop(fs);					/* Directory indexes are built on first lookup */
+#endif
 	stat = disk_initialize(fs->pdrv);	/* Initialize the volume hosting physical drive */
 	if (stat & STA_NOINIT) { 			/* Check if the initialization succeeded */
 		return FR_NOT_READY;			/* Failed to initialize due to no medium or hard error */
@@ -4945,8 +5476,10 @@ FRESULT f_getfree (
 	FRESULT res;
 	FATFS *fs;
 	DWORD nfree, clst, stat;
+#if !FF_FREE_MAP || FF_FS_EXFAT
 	LBA_t sect;
 	UINT i;
+#endif
 	FFOBJID obj;
 
 
@@ -4996,23 +5529,30 @@ FRESULT f_getfree (
 				} else
 #endif
 				{	/* FAT16/32: Scan WORD/DWORD FAT entries */
+#if FF_FREE_MAP
+					res = build_free_map(fs, &nfree);	/* Count free entries, (re)building the free cluster map on the way */
+#else
+					BYTE *fat = 0;
+
 					clst = fs->n_fatent;	/* Number of entries */
 					sect = fs->fatbase;		/* Top of the FAT */
 					i = 0;					/* Offset in the sector */
 					do {	/* Counts numbuer of entries with zero in the FAT */
 						if (i == 0) {	/* New sector? */
-							res = move_window(fs, sect++);
-							if (res != FR_OK) break;
+							if (!(fat = fat_sector(fs, sect++))) {
+								res = FR_DISK_ERR; break;
+							}
 						}
 						if (fs->fs_type == FS_FAT16) {
-							if (ld_16(fs->win + i) == 0) nfree++;	/* FAT16: Is this cluster free? */
+							if (ld_16(fat + i) == 0) nfree++;	/* FAT16: Is this cluster free? */
 							i += 2;	/* Next entry */
 						} else {
-							if ((ld_32(fs->win + i) & 0x0FFFFFFF) == 0) nfree++;	/* FAT32: Is this cluster free? */
+							if ((ld_32(fat + i) & 0x0FFFFFFF) == 0) nfree++;	/* FAT32: Is this cluster free? */
 							i += 4;	/* Next entry */
 						}
 						i %= SS(fs);
 					} while (--clst);
+#endif
 				}
 			}
 			if (res == FR_OK) {		/* Update parameters if succeeded */
@@ -166,6 +166,7 @@ typedef struct {
 #if !FF_FS_READONLY
 	DWORD	last_clst;	/* Last allocated cluster (invalid if >=n_fatent) */
 	DWORD	free_clst;	/* Number of free clusters (invalid if >=fs->n_fatent-2) */
+	DWORD	wcnt;		/* Number of win[] write-backs (a directory change reaches the disk through it) */
 #endif
 #if FF_FS_RPATH
 	DWORD	cdir;		/* Current directory start cluster (0:root) */
@@ -184,6 +185,18 @@ typedef struct {
 	FFXCWDS	xcwds;		/* Crrent working directory structure */
 	FFXCWDS	xcwds2;		/* Working buffer to follow the path */
 #endif
+#endif
+#if FF_FAT_CACHE
+	DWORD	fctick;		/* FAT cache LRU clock */
+	UINT	fclast;		/* FAT cache slot returned last */
+	LBA_t	fcsect[FF_FAT_CACHE];	/* Sector in each FAT cache slot ((LBA_t)-1:empty) */
+	DWORD	fcuse[FF_FAT_CACHE];	/* LRU stamp of each slot */
+	BYTE	fcflag[FF_FAT_CACHE];	/* Slot status (b0:dirty) */
+	BYTE	(*fcbuf)[FF_MAX_SS];	/* FAT cache buffers */
+#endif
+#if FF_FREE_MAP && !FF_FS_READONLY
+	BYTE	fmstat;		/* Free cluster map status (0:not built, 1:valid, 2:not available) */
+	DWORD*	fmap;		/* Free cluster map (bit per FAT sector, 1:may have a free entry) */
 #endif
 	BYTE	win[FF_MAX_SS];	/* Disk access window for directory, FAT (and file data in tiny cfg) */
 } FATFS;
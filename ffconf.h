@@ -34,11 +34,11 @@
 /* This option switches f_mkfs(). (0:Disable or 1:Enable) */
 
 
-#define FF_USE_FASTSEEK	0
+#define FF_USE_FASTSEEK	1
 /* This option switches fast seek feature. (0:Disable or 1:Enable) */
 
 
-#define FF_USE_EXPAND	0
+#define FF_USE_EXPAND	1
 /* This option switches f_expand(). (0:Disable or 1:Enable) */
 
 
@@ -243,6 +243,60 @@
 /  buffer in the filesystem object (FATFS) is used for the file data transfer. */
 
 
+#ifdef CONFIG_FAT_CACHE
+#define FF_FAT_CACHE	8
+#else
+#define FF_FAT_CACHE	0
+#endif
+#define FF_FAT_CACHE_ATTR	__attribute__((section(".kbuf")))
+/* Number of FAT sectors kept in a cache of their own, apart from the win[].
+/  (0:Disable or 2 or more:Enable)
+/  FAT sectors read and written by the cluster chain functions stay in the cache,
+/  so following a chain neither evicts the directory sector in the win[] nor
+/  reads the same FAT sector from the disk again. Changed FAT sectors are written
+/  to all FAT copies when evicted and when the filesystem is synchronized.
+/  The buffers take FF_FAT_CACHE * FF_MAX_SS bytes per volume and are declared
+/  with FF_FAT_CACHE_ATTR, which can place them in a particular section.
+/  Enabled by the FAT_CACHE build option (OPTIONS in the Makefile). */
+
+
+#ifdef CONFIG_FREE_MAP
+#define FF_FREE_MAP		1
+#else
+#define FF_FREE_MAP		0
+#endif
+#define FF_FREE_MAP_BYTES	2048
+#define FF_FREE_MAP_ATTR	__attribute__((section(".kbuf")))
+/* This option switches the free cluster map on FAT16/FAT32 volumes. (0:Disable or 1:Enable)
+/  The map holds one bit per FAT sector, set while the sector may contain a free
+/  entry. It is built by the first cluster search or f_getfree() scan after the
+/  volume is mounted, and lets the cluster search skip full parts of the FAT a
+/  word of the map at a time instead of reading every entry. FF_FREE_MAP_BYTES
+/  limits the map size (2048 bytes cover 16384 FAT sectors, 2M FAT32 clusters);
+/  larger volumes fall back to the linear search. The map is declared with
+/  FF_FREE_MAP_ATTR. This option has no effect when FF_FS_READONLY == 1.
+/  Enabled by the FREE_MAP build option (OPTIONS in the Makefile). */
+
+
+#ifdef CONFIG_DIR_INDEX
+#define FF_DIR_INDEX	2
+#else
+#define FF_DIR_INDEX	0
+#endif
+#define FF_DIR_INDEX_SLOTS	1024
+#define FF_DIR_INDEX_ATTR	__attribute__((section(".kbuf")))
+/* Number of directories with a name index. (0:Disable or 1 or more:Enable)
+/  The first lookup in a directory reads it once and indexes its entries in a
+/  hash table of the SFNs, after that a lookup reads only the sector holding the
+/  matching entry, and none if the name does not exist. New entries are added
+/  to the index, removing an entry drops the indexes of the volume. The least
+/  recently used index is rebuilt for another directory. FF_DIR_INDEX_SLOTS is
+/  the table size (power of 2, 4 bytes each); a directory with more than 3/4 of
+/  that many entries is searched linearly. The tables are declared with
+/  FF_DIR_INDEX_ATTR. This option has no effect when FF_USE_LFN != 0.
+/  Enabled by the DIR_INDEX build option (OPTIONS in the Makefile). */
+
+
 #define FF_FS_EXFAT		0
 /* This option switches support for exFAT filesystem. (0:Disable or 1:Enable)
 /  To enable exFAT, also LFN needs to be enabled. (FF_USE_LFN >= 1)
@@ -3,6 +3,7 @@
 # --- Configuration ---
 KERNEL_BIN="kernel.bin"
 APPS_DIR="apps"
+BOOT_BYTES=32768    # Boot ROM copies 64 sectors; apps load right after (soc.h)
 
 # Normalize app directory
 if [ ! -d "$APPS_DIR" ] && [ -d "app" ]; then APPS_DIR="app"; fi
@@ -13,6 +14,10 @@ if [ ! -f "$KERNEL_BIN" ]; then
     KERNEL_EXISTS=false
 else
     KERNEL_EXISTS=true
+    if [ $(wc -c < "$KERNEL_BIN") -gt $BOOT_BYTES ]; then
+        echo "ERROR: '$KERNEL_BIN' is larger than the $BOOT_BYTES bytes the boot ROM loads."
+        exit 1
+    fi
 fi
 
 # List Disks
@@ -39,7 +44,7 @@ else
 fi
 
 if [ -d "$APPS_DIR" ]; then
-    read -p "[2] Install Apps (Copy *.bin)? [y/N]: " DO_APPS
+    read -p "[2] Install Apps (Copy *.bin, *.elf, *.lzb)? [y/N]: " DO_APPS
 else
     DO_APPS="n"
 fi
@@ -89,7 +94,7 @@ if [[ "$DO_APPS" == "y" || "$DO_APPS" == "Y" ]]; then
         
         # Install Apps
         echo "Installing apps..."
-        for f in $APPS_DIR/*.bin; do
+        for f in $APPS_DIR/*.bin $APPS_DIR/*.elf $APPS_DIR/*.lzb; do
             [ -e "$f" ] || continue
             # -X strips resource forks during copy
             cp -X "$f" "$MOUNT_POINT/"
@@ -0,0 +1,78 @@
+#include "fmt.h"
+
+// Decimal digits are found by subtracting powers of ten: at most nine
+// compare/subtract steps per digit, all single-cycle-class instructions.
+static const uint32_t pow10_32[10] = {
+    1000000000, 100000000, 10000000, 1000000, 100000,
+    10000, 1000, 100, 10, 1
+};
+
+// Powers for the digits a 64-bit value has above 10^9
+static const uint64_t pow10_64[11] = {
+    10000000000000000000ull, 1000000000000000000ull, 100000000000000000ull,
+    10000000000000000ull, 1000000000000000ull, 100000000000000ull,
+    10000000000000ull, 1000000000000ull, 100000000000ull,
+    10000000000ull, 1000000000ull
+};
+
+static const char hex_digits[16] = {
+    '0', '1', '2', '3', '4', '5', '6', '7',
+    '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+};
+
+char *fmt_str(char *p, const char *s) {
+    while (*s) *p++ = *s++;
+    return p;
+}
+
+char *fmt_dec(char *p, uint32_t val, int width) {
+    int i = 0;
+
+    // Drop leading zeros the width does not ask for, keeping the last digit
+    while (i < 9 && val < pow10_32[i] && 10 - i > width) i++;
+
+    for (; i < 10; i++) {
+        uint32_t pw = pow10_32[i];
+        char d = '0';
+        while (val >= pw) {
+            val -= pw;
+            d++;
+        }
+        *p++ = d;
+    }
+    return p;
+}
+
+char *fmt_u64(char *p, uint64_t val) {
+    if (!(val >> 32)) return fmt_dec(p, (uint32_t)val, 1);
+
+    // val >= 2^32 > 10^9, so the first non-zero digit is in the table
+    int i = 0;
+    while (val < pow10_64[i]) i++;
+
+    for (; i < 11; i++) {
+        uint64_t pw = pow10_64[i];
+        char d = '0';
+        while (val >= pw) {
+            val -= pw;
+            d++;
+        }
+        *p++ = d;
+    }
+
+    // What is left is below 10^9: the last nine digits, zero-padded
+    return fmt_dec(p, (uint32_t)val, 9);
+}
+
+char *fmt_hex(char *p, uint32_t val, int digits) {
+    for (int s = (digits - 1) * 4; s >= 0; s -= 4) {
+        *p++ = hex_digits[(val >> s) & 0xF];
+    }
+    return p;
+}
+
+char *fmt_byte(char *p, uint8_t b) {
+    p[0] = hex_digits[b >> 4];
+    p[1] = hex_digits[b & 0xF];
+    return p + 2;
+}
@@ -0,0 +1,31 @@
+#ifndef FMT_H
+#define FMT_H
+
+#include <stdint.h>
+
+// Number formatting into a caller buffer, without division (RV32I has no
+// divider; every / or % is a libgcc call costing hundreds of cycles).
+// Each formatter writes at 'p', adds no terminator and returns the position
+// just past the last character, so a whole line can be built and sent with
+// one uart_write():
+//     char line[32];
+//     char *p = fmt_str(line, "x = ");
+//     p = fmt_dec(p, x, 1);
+//     uart_write(line, p - line);
+
+// Copy a string (without its terminator)
+char *fmt_str(char *p, const char *s);
+
+// Unsigned decimal, zero-padded to at least 'width' digits (max 10 digits)
+char *fmt_dec(char *p, uint32_t val, int width);
+
+// Unsigned 64-bit decimal (max 20 digits)
+char *fmt_u64(char *p, uint64_t val);
+
+// The low 'digits' nibbles of 'val' as upper-case hex, no prefix (max 8)
+char *fmt_hex(char *p, uint32_t val, int digits);
+
+// One byte as two hex digits
+char *fmt_byte(char *p, uint8_t b);
+
+#endif
@@ -0,0 +1,282 @@
+#include <string.h>
+#include "hostlink.h"
+#include "ymodem.h"     // crc16_update
+#include "uart.h"
+#include "ff.h"
+#include "diskio.h"
+#include "mount.h"
+#include "loader.h"
+#include "soc.h"
+
+// Largest decoded frame: op, seq/status, 4-byte argument, data, CRC
+#define HL_FRAME    (HL_MAX_DATA + 16)
+
+static uint8_t rx_buf[HL_FRAME] KBUF;
+static uint8_t reply[HL_FRAME] KBUF;
+static uint8_t tx_buf[HL_FRAME + HL_FRAME / 254 + 4] KBUF;   // COBS + delimiters
+static uint32_t tx_len;
+
+static FIL file;
+static uint8_t file_open;
+static uint8_t raw_card;    // Card initialized for sector access, volume unmounted
+
+static uint32_t get16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static uint32_t get32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+// COBS: every run of non-zero bytes is prefixed with its length + 1, a zero
+// byte is implied after each run shorter than 254. Returns the encoded size.
+static uint32_t cobs_encode(const uint8_t *src, uint32_t len, uint8_t *dst) {
+    uint32_t out = 1, code_at = 0;
+    uint8_t code = 1;
+    for (uint32_t i = 0; i < len; i++) {
+        if (src[i] == 0) {
+            dst[code_at] = code;
+            code_at = out++;
+            code = 1;
+            continue;
+        }
+        dst[out++] = src[i];
+        if (++code == 0xFF) {
+            dst[code_at] = code;
+            code_at = out++;
+            code = 1;
+        }
+    }
+    dst[code_at] = code;
+    return out;
+}
+
+// Decode in place (the output never overtakes the input). Returns the
+// decoded size, or -1 if a run points past the end.
+static int cobs_decode(uint8_t *buf, uint32_t len) {
+    uint32_t in = 0, out = 0;
+    while (in < len) {
+        uint32_t code = buf[in++];
+        if (in + code - 1 > len) return -1;
+        for (uint32_t i = 1; i < code; i++) buf[out++] = buf[in++];
+        if (code < 0xFF && in < len) buf[out++] = 0;
+    }
+    return out;
+}
+
+// Wait for the next frame with a good CRC. Returns its length without the CRC.
+// Bytes before the first delimiter (shell echo, line noise) and frames that
+// overflow the buffer are dropped.
+static int read_frame(void) {
+    uint32_t n = 0;
+    int overflow = 0;
+    while (1) {
+        uint8_t c = getc();
+        if (c != 0) {
+            if (n < sizeof(rx_buf)) rx_buf[n++] = c;
+            else overflow = 1;
+            continue;
+        }
+        int len = (n && !overflow) ? cobs_decode(rx_buf, n) : -1;
+        n = 0;
+        overflow = 0;
+        if (len < 4) continue;
+        len -= 2;
+        if (crc16_update(0, rx_buf, len) == ((rx_buf[len] << 8) | rx_buf[len + 1])) return len;
+    }
+}
+
+// Send reply[0 .. 3 + len) with its CRC. It stays in tx_buf for repeats.
+static void send_reply(uint8_t status, uint32_t len) {
+    reply[2] = status;
+    len += 3;
+    uint16_t crc = crc16_update(0, reply, len);
+    reply[len++] = crc >> 8;
+    reply[len++] = crc;
+
+    tx_buf[0] = 0;
+    tx_len = 1 + cobs_encode(reply, len, tx_buf + 1);
+    tx_buf[tx_len++] = 0;
+    uart_write((const char *)tx_buf, tx_len);
+}
+
+static void close_file(void) {
+    if (!file_open) return;
+    fs_result(f_close(&file));
+    file_open = 0;
+    app_cache_invalidate();
+}
+
+// Sector access bypasses FatFs, so take the volume down first: its window and
+// any open file would not see the new sectors. The next file request mounts
+// again.
+static int card_ready(void) {
+    if (raw_card) return 1;
+    close_file();
+    fs_unmount();
+    if (disk_initialize(0) != 0) return 0;
+    raw_card = 1;
+    return 1;
+}
+
+static uint8_t fs_status(FRESULT res, uint32_t *len) {
+    if (res == FR_OK) return HL_OK;
+    reply[3] = fs_result(res);
+    *len = 1;
+    return HL_FS;
+}
+
+// Run one request from rx_buf[0 .. len). Returns the status; reply data
+// (its length in *out) is already in reply[3 ..].
+static uint8_t dispatch(const uint8_t *args, uint32_t alen, uint32_t *out, void (*run)(uint32_t)) {
+    uint8_t *data = reply + 3;
+    uint8_t op = reply[0] & 0x7F;
+    *out = 0;
+
+    switch (op) {
+    case HL_PING:
+        memcpy(data, "PMON", 4);
+        data[4] = HL_VERSION;
+        data[5] = HL_MAX_DATA & 0xFF;
+        data[6] = HL_MAX_DATA >> 8;
+        *out = 7;
+        return HL_OK;
+
+    case HL_MEM_READ: {
+        if (alen < 6) return HL_BAD_ARG;
+        uint32_t n = get16(args + 4);
+        if (n > HL_MAX_DATA) return HL_BAD_ARG;
+        memcpy(data, (const void *)get32(args), n);
+        *out = n;
+        return HL_OK;
+    }
+
+    case HL_MEM_WRITE:
+        if (alen < 4) return HL_BAD_ARG;
+        memcpy((void *)get32(args), args + 4, alen - 4);
+        return HL_OK;
+
+    case HL_MEM_CRC: {
+        if (alen < 8) return HL_BAD_ARG;
+        uint16_t crc = crc16_update(0, (const uint8_t *)get32(args), get32(args + 4));
+        data[0] = crc; data[1] = crc >> 8;
+        *out = 2;
+        return HL_OK;
+    }
+
+    case HL_SECT_READ: {
+        if (alen < 5) return HL_BAD_ARG;
+        uint32_t count = args[4];
+        if (count == 0 || count > HL_MAX_DATA / 512) return HL_BAD_ARG;
+        if (!card_ready()) return HL_DISK;
+        if (disk_read(0, data, get32(args), count) != RES_OK) {
+            raw_card = 0;
+            return HL_DISK;
+        }
+        *out = count * 512;
+        return HL_OK;
+    }
+
+    case HL_SECT_WRITE: {
+        uint32_t n = alen - 4;
+        if (alen < 4 + 512 || (n & 511)) return HL_BAD_ARG;
+        if (!card_ready()) return HL_DISK;
+        DRESULT res = disk_write(0, args + 4, get32(args), n >> 9);
+        if (res == RES_OK) res = disk_ioctl(0, CTRL_SYNC, 0);
+        app_cache_invalidate();
+        if (res != RES_OK) {
+            raw_card = 0;
+            return HL_DISK;
+        }
+        return HL_OK;
+    }
+
+    case HL_FILE_OPEN: {
+        if (alen < 2) return HL_BAD_ARG;
+        close_file();
+        FRESULT res = fs_ready();
+        if (res != FR_OK) return fs_status(res, out);
+        raw_card = 0;
+        BYTE mode = args[0] ? FA_WRITE | FA_CREATE_ALWAYS : FA_READ;
+        res = f_open(&file, (const char *)args + 1, mode);
+        if (res != FR_OK) return fs_status(res, out);
+        file_open = 1;
+        put32(data, f_size(&file));
+        *out = 4;
+        return HL_OK;
+    }
+
+    case HL_FILE_READ: {
+        if (alen < 2 || !file_open) return HL_BAD_ARG;
+        uint32_t n = get16(args);
+        if (n > HL_MAX_DATA) return HL_BAD_ARG;
+        UINT br;
+        FRESULT res = f_read(&file, data, n, &br);
+        if (res != FR_OK) return fs_status(res, out);
+        *out = br;
+        return HL_OK;
+    }
+
+    case HL_FILE_WRITE: {
+        if (!file_open) return HL_BAD_ARG;
+        UINT bw;
+        FRESULT res = f_write(&file, args, alen, &bw);
+        if (res == FR_OK && bw != alen) res = FR_DENIED; // Volume full
+        return fs_status(res, out);
+    }
+
+    case HL_FILE_CLOSE: {
+        if (!file_open) return HL_OK;
+        FRESULT res = f_close(&file);
+        file_open = 0;
+        app_cache_invalidate();
+        return fs_status(res, out);
+    }
+
+    case HL_JUMP:
+        if (alen < 4) return HL_BAD_ARG;
+        send_reply(HL_OK, 0);
+        uart_flush();
+        run(get32(args));
+        return HL_RETURNED;
+
+    default:
+        return HL_BAD_OP;
+    }
+}
+
+void hostlink_serve(void (*run)(uint32_t addr)) {
+    int have_last = 0;
+
+    // A delimiter ends whatever the host saw before (command echo, banner)
+    putc(0);
+
+    while (1) {
+        int len = read_frame();
+        uint8_t op = rx_buf[0];
+        uint8_t seq = rx_buf[1];
+
+        // The host lost our reply: send it again rather than redo the request
+        if (have_last && op == (reply[0] & 0x7F) && seq == reply[1]) {
+            uart_write((const char *)tx_buf, tx_len);
+            continue;
+        }
+
+        reply[0] = op | 0x80;
+        reply[1] = seq;
+        have_last = 1;
+
+        if (op == HL_EXIT) {
+            close_file();
+            send_reply(HL_OK, 0);
+            uart_flush();
+            return;
+        }
+
+        // Path arguments end at the CRC; terminate them in its place
+        rx_buf[len] = 0;
+
+        uint32_t out;
+        uint8_t status = dispatch(rx_buf + 2, len - 2, &out, run);
+        send_reply(status, out);
+    }
+}
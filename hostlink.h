@@ -0,0 +1,49 @@
+#ifndef HOSTLINK_H
+#define HOSTLINK_H
+
+#include <stdint.h>
+
+// Binary host link: a request/reply protocol for test rigs and scripts
+// (tools/hostlink.py), so images move at close to the raw baud rate instead
+// of through peek/poke/dump text.
+//
+// Framing: each frame is COBS encoded and sent between 0x00 delimiters
+// (one before, one after). The decoded frame is
+//     request: op, seq, args...          , crc16 (big endian)
+//     reply:   op | 0x80, seq, status, data..., crc16
+// with the CRC-16/XMODEM of everything before it. Multi-byte arguments are
+// little endian. Frames with a bad CRC are dropped without a reply; the host
+// times out and sends the request again with the same seq, and a repeated
+// seq gets the previous reply back without running the request twice.
+
+#define HL_MAX_DATA     1024    // Payload bytes per request or reply
+
+// Opcodes (arguments -> reply data)
+#define HL_PING         0x01    // -> "PMON", version, max data (u16)
+#define HL_MEM_READ     0x02    // addr u32, len u16 -> bytes
+#define HL_MEM_WRITE    0x03    // addr u32, bytes
+#define HL_MEM_CRC      0x04    // addr u32, len u32 -> crc16 (u16)
+#define HL_SECT_READ    0x05    // lba u32, count u8 -> count * 512 bytes
+#define HL_SECT_WRITE   0x06    // lba u32, count * 512 bytes
+#define HL_FILE_OPEN    0x07    // mode u8 (0 read, 1 write), path -> size (u32)
+#define HL_FILE_READ    0x08    // len u16 -> bytes (short at end of file)
+#define HL_FILE_WRITE   0x09    // bytes
+#define HL_FILE_CLOSE   0x0A
+#define HL_JUMP         0x0B    // addr u32 -> OK, then HL_RETURNED when it returns
+#define HL_EXIT         0x0C    // Leave host link mode
+
+// Reply status
+#define HL_OK           0
+#define HL_RETURNED     1       // Second reply to HL_JUMP: the program returned
+#define HL_BAD_OP       2
+#define HL_BAD_ARG      3       // Length out of range, or no file open
+#define HL_DISK         4       // Card did not initialize, or sector I/O failed
+#define HL_FS           5       // FatFs error; data holds the FRESULT byte
+
+#define HL_VERSION      1
+
+// Serve requests until HL_EXIT. 'run' starts a program for HL_JUMP and
+// returns when it does.
+void hostlink_serve(void (*run)(uint32_t addr));
+
+#endif
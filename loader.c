@@ -0,0 +1,411 @@
+#include <string.h>
+#include "loader.h"
+#include "diskio.h"
+#include "soc.h"
+
+// Fast-seek cluster map: [table size, (length, first cluster)..., 0].
+// FatFs merges adjacent clusters, so each pair is one contiguous extent.
+#define LOADER_MAX_EXTENTS 32
+static DWORD clmt[2 * (LOADER_MAX_EXTENTS + 1)] KBUF;
+
+// ELF32 (only the fields the loader needs to understand)
+typedef struct {
+    uint8_t  e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;
+    uint32_t e_phoff;
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} Elf32_Ehdr;
+
+typedef struct {
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+} Elf32_Phdr;
+
+#define ET_EXEC     2
+#define EM_RISCV    243
+#define PT_LOAD     1
+#define PF_X        1
+#define ELF_MAX_PHDRS 8
+
+// Compressed flat image written by tools/lz4pack.py
+typedef struct {
+    uint8_t  magic[4];      // 'L','Z','4','P'
+    uint32_t load_addr;     // Decompress to (and enter at) this address
+    uint32_t size;          // Decompressed size
+} LzHeader;
+
+// Sector-at-a-time input for the decompressor. Whole aligned sectors let
+// f_read() bypass fp->buf and go straight to the card.
+typedef struct {
+    FIL     *f;
+    uint8_t  buf[512];
+    UINT     pos;
+    UINT     len;
+} LzInput;
+
+// Resolve the cluster chain once. On success f->cltbl stays set, so the
+// f_lseek()/f_read() calls that follow never walk the FAT again.
+static FRESULT build_map(FIL *f) {
+    clmt[0] = sizeof(clmt) / sizeof(clmt[0]);
+    f->cltbl = clmt;
+    FRESULT res = f_lseek(f, CREATE_LINKMAP);
+    if (res != FR_OK) f->cltbl = 0;
+    return res;
+}
+
+// Read the whole file with one disk_read() (one CMD18 stream) per extent.
+// The last sector is read whole, so up to 511 bytes past the file end are
+// overwritten too; the caller has checked the rounded size fits.
+static FRESULT load_extents(FIL *f, uint8_t *dst, UINT *br) {
+    FATFS *fs = f->obj.fs;
+    DWORD sectors = (f_size(f) + 511) / 512;
+    DWORD *tbl = clmt + 1;
+
+    while (sectors && *tbl) {
+        DWORD ncl = *tbl++;
+        DWORD clst = *tbl++;
+        LBA_t sect = fs->database + (LBA_t)(clst - 2) * fs->csize;
+        DWORD n = ncl * fs->csize;
+        if (n > sectors) n = sectors;
+
+        if (disk_read(fs->pdrv, dst, sect, n) != RES_OK) return FR_DISK_ERR;
+        dst += n * 512;
+        sectors -= n;
+    }
+    if (sectors) return FR_INT_ERR; // Chain shorter than the file size
+
+    *br = f_size(f);
+    return FR_OK;
+}
+
+// Flat binary: the file is the memory image at USER_PROG_ADDR
+static FRESULT load_flat(FIL *f, int mapped, AppImage *img) {
+    uint8_t *load_addr = (uint8_t*)USER_PROG_ADDR;
+    FRESULT res;
+
+    if (((f_size(f) + 511) & ~511) > USER_PROG_END - USER_PROG_ADDR) return FR_NOT_ENOUGH_CORE;
+
+    if (mapped) {
+        res = load_extents(f, load_addr, &img->size);
+    } else {
+        // Too fragmented for the map: fall back to the cluster-by-cluster path
+        res = f_lseek(f, 0);
+        if (res == FR_OK) res = f_read(f, load_addr, f_size(f), &img->size);
+    }
+
+    img->entry = img->addr = USER_PROG_ADDR;
+    img->len = img->size;
+    return res;
+}
+
+#if defined(CONFIG_ELF) || defined(CONFIG_LZ4)
+static int in_user_area(uint32_t addr, uint32_t len) {
+    return addr >= USER_PROG_ADDR && addr <= USER_PROG_END && len <= USER_PROG_END - addr;
+}
+#endif
+
+#ifdef CONFIG_ELF
+// ELF32: copy only the PT_LOAD file bytes and zero the p_memsz - p_filesz
+// tail in RAM, so .bss and large zeroed buffers cost nothing to load.
+static FRESULT load_elf(FIL *f, const Elf32_Ehdr *eh, AppImage *img) {
+    Elf32_Phdr ph[ELF_MAX_PHDRS];
+    UINT br;
+    FRESULT res;
+    int entry_ok = 0;
+
+    if (eh->e_ident[4] != 1 || eh->e_ident[5] != 1 ||   // ELFCLASS32, little-endian
+        eh->e_type != ET_EXEC || eh->e_machine != EM_RISCV ||
+        eh->e_phentsize != sizeof(Elf32_Phdr) || eh->e_phnum > ELF_MAX_PHDRS) {
+        return FR_INVALID_OBJECT;
+    }
+
+    res = f_lseek(f, eh->e_phoff);
+    if (res == FR_OK) res = f_read(f, ph, eh->e_phnum * sizeof(Elf32_Phdr), &br);
+    if (res != FR_OK) return res;
+    if (br != eh->e_phnum * sizeof(Elf32_Phdr)) return FR_INVALID_OBJECT;
+
+    // Validate every segment before touching RAM
+    for (int i = 0; i < eh->e_phnum; i++) {
+        if (ph[i].p_type != PT_LOAD || ph[i].p_memsz == 0) continue;
+        if (ph[i].p_filesz > ph[i].p_memsz ||
+            ph[i].p_offset + ph[i].p_filesz > f_size(f) ||
+            !in_user_area(ph[i].p_vaddr, ph[i].p_memsz)) {
+            return FR_NOT_ENOUGH_CORE;
+        }
+        if ((ph[i].p_flags & PF_X) && eh->e_entry >= ph[i].p_vaddr &&
+            eh->e_entry - ph[i].p_vaddr < ph[i].p_memsz) {
+            entry_ok = 1;
+        }
+    }
+    if (!entry_ok) return FR_INVALID_OBJECT;
+
+    uint32_t lo = USER_PROG_END, hi = USER_PROG_ADDR;
+    img->size = 0;
+    for (int i = 0; i < eh->e_phnum; i++) {
+        if (ph[i].p_type != PT_LOAD || ph[i].p_memsz == 0) continue;
+        uint8_t *dst = (uint8_t*)ph[i].p_vaddr;
+
+        if (ph[i].p_filesz) {
+            res = f_lseek(f, ph[i].p_offset);
+            if (res == FR_OK) res = f_read(f, dst, ph[i].p_filesz, &br);
+            if (res != FR_OK) return res;
+            if (br != ph[i].p_filesz) return FR_INVALID_OBJECT;
+        }
+        memset(dst + ph[i].p_filesz, 0, ph[i].p_memsz - ph[i].p_filesz);
+        img->size += ph[i].p_memsz;
+        if (ph[i].p_vaddr < lo) lo = ph[i].p_vaddr;
+        if (ph[i].p_vaddr + ph[i].p_memsz > hi) hi = ph[i].p_vaddr + ph[i].p_memsz;
+    }
+
+    img->entry = eh->e_entry;
+    img->addr = lo;
+    img->len = hi - lo;
+    return FR_OK;
+}
+#endif // CONFIG_ELF
+
+#ifdef CONFIG_LZ4
+static int lz_refill(LzInput *in) {
+    if (f_read(in->f, in->buf, sizeof(in->buf), &in->len) != FR_OK) in->len = 0;
+    in->pos = 0;
+    return in->len != 0;
+}
+
+static inline int lz_byte(LzInput *in) {
+    if (in->pos == in->len && !lz_refill(in)) return -1;
+    return in->buf[in->pos++];
+}
+
+// LZ4 length extension: keep adding bytes while they are 255
+static inline int lz_length(LzInput *in, UINT *len) {
+    int b;
+    do {
+        if ((b = lz_byte(in)) < 0) return -1;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+// LZ4 image: decompress the LZ4 block stream sector by sector as it is read,
+// straight into the load address. Literal runs are copied out of the input
+// sector in bulk; matches are copied bytewise since they may overlap.
+static FRESULT load_lz4(FIL *f, AppImage *img) {
+    LzHeader hdr;
+    LzInput in;
+    UINT br;
+
+    FRESULT res = f_lseek(f, 0);
+    if (res == FR_OK) res = f_read(f, &hdr, sizeof(hdr), &br);
+    if (res != FR_OK) return res;
+    if (!in_user_area(hdr.load_addr, hdr.size)) return FR_NOT_ENOUGH_CORE;
+
+    // Read the rest of the first sector, then whole sectors from here on
+    in.f = f;
+    in.pos = 0;
+    res = f_read(f, in.buf, sizeof(in.buf) - sizeof(hdr), &in.len);
+    if (res != FR_OK) return res;
+
+    uint8_t *base = (uint8_t*)hdr.load_addr;
+    uint8_t *out = base;
+    uint8_t *end = base + hdr.size;
+
+    while (out < end) {
+        int token = lz_byte(&in);
+        if (token < 0) return FR_INVALID_OBJECT;
+
+        UINT lit = token >> 4;
+        if (lit == 15 && lz_length(&in, &lit) < 0) return FR_INVALID_OBJECT;
+        if (lit > (UINT)(end - out)) return FR_INVALID_OBJECT;
+        while (lit) {
+            if (in.pos == in.len && !lz_refill(&in)) return FR_INVALID_OBJECT;
+            UINT n = in.len - in.pos;
+            if (n > lit) n = lit;
+            memcpy(out, in.buf + in.pos, n);
+            out += n; in.pos += n; lit -= n;
+        }
+        if (out == end) break; // The last sequence has no match
+
+        int lo = lz_byte(&in);
+        int hi = lz_byte(&in);
+        if (lo < 0 || hi < 0) return FR_INVALID_OBJECT;
+        UINT offset = lo | (hi << 8);
+        if (offset == 0 || offset > (UINT)(out - base)) return FR_INVALID_OBJECT;
+
+        UINT mlen = token & 15;
+        if (mlen == 15 && lz_length(&in, &mlen) < 0) return FR_INVALID_OBJECT;
+        mlen += 4;
+        if (mlen > (UINT)(end - out)) return FR_INVALID_OBJECT;
+
+        const uint8_t *src = out - offset;
+        while (mlen--) *out++ = *src++;
+    }
+
+    img->entry = img->addr = hdr.load_addr;
+    img->len = img->size = hdr.size;
+    return FR_OK;
+}
+#endif // CONFIG_LZ4
+
+// RAM APP CACHE
+// ==========================================
+// Snapshots of freshly loaded images, keyed by path, size and timestamp.
+// Snapshots are appended to a ring arena in .kbuf; when the arena wraps, the
+// entries it overwrites are dropped. A hit costs an f_stat() and a memcpy.
+// The snapshot is taken before the app runs, so its .data/.bss start clean.
+// Built with CONFIG_APP_CACHE.
+
+#ifdef CONFIG_APP_CACHE
+#ifndef APP_CACHE_BYTES
+#define APP_CACHE_BYTES  0x18000    // 96KB
+#endif
+#define APP_CACHE_SLOTS  4
+#define APP_CACHE_PATH   32
+
+typedef struct {
+    char     path[APP_CACHE_PATH];
+    FSIZE_t  fsize;
+    WORD     fdate;
+    WORD     ftime;
+    uint32_t offset;        // Snapshot position in app_arena
+    AppImage img;
+    uint32_t seq;           // Insertion order, oldest is evicted first
+    uint8_t  valid;
+} AppCacheEntry;
+
+static uint8_t app_arena[APP_CACHE_BYTES] KBUF;
+static AppCacheEntry app_cache[APP_CACHE_SLOTS];
+static uint32_t app_next;   // Arena offset for the next snapshot
+static uint32_t app_seq;
+
+static int path_eq(const char *a, const char *b) {
+    while (*a && *a == *b) { a++; b++; }
+    return *a == *b;
+}
+
+static AppCacheEntry *app_cache_find(const char *path, const FILINFO *fno) {
+    for (int i = 0; i < APP_CACHE_SLOTS; i++) {
+        AppCacheEntry *e = &app_cache[i];
+        if (e->valid && e->fsize == fno->fsize && e->fdate == fno->fdate &&
+            e->ftime == fno->ftime && path_eq(e->path, path)) {
+            return e;
+        }
+    }
+    return 0;
+}
+
+static void app_cache_store(const char *path, const FILINFO *fno, const AppImage *img) {
+    size_t plen = strlen(path);
+    if (img->len > APP_CACHE_BYTES || plen >= APP_CACHE_PATH) return;
+
+    if (app_next + img->len > APP_CACHE_BYTES) app_next = 0;
+
+    // Drop older versions of this file and snapshots we are about to overwrite
+    AppCacheEntry *slot = 0;
+    for (int i = 0; i < APP_CACHE_SLOTS; i++) {
+        AppCacheEntry *e = &app_cache[i];
+        if (e->valid && (path_eq(e->path, path) ||
+            (e->offset < app_next + img->len && app_next < e->offset + e->img.len))) {
+            e->valid = 0;
+        }
+        if (!e->valid) {
+            if (!slot || slot->valid) slot = e;
+        } else if (!slot || (slot->valid && e->seq < slot->seq)) {
+            slot = e;
+        }
+    }
+
+    memcpy(app_arena + app_next, (const void*)img->addr, img->len);
+    memcpy(slot->path, path, plen + 1);
+    slot->fsize = fno->fsize;
+    slot->fdate = fno->fdate;
+    slot->ftime = fno->ftime;
+    slot->offset = app_next;
+    slot->img = *img;
+    slot->seq = ++app_seq;
+    slot->valid = 1;
+    app_next += (img->len + 3) & ~3;
+}
+
+void app_cache_invalidate(void) {
+    for (int i = 0; i < APP_CACHE_SLOTS; i++) app_cache[i].valid = 0;
+    app_next = 0;
+}
+#else
+void app_cache_invalidate(void) {}
+#endif
+
+FRESULT load_app(const char *path, AppImage *img) {
+    FIL f;
+    FRESULT res;
+    Elf32_Ehdr eh;
+    UINT br = 0;
+
+    img->size = 0;
+    img->cached = 0;
+
+#ifdef CONFIG_APP_CACHE
+    FILINFO fno;
+    res = f_stat(path, &fno);
+    if (res != FR_OK) return res;
+
+    AppCacheEntry *hit = app_cache_find(path, &fno);
+    if (hit) {
+        *img = hit->img;
+        memcpy((void*)img->addr, app_arena + hit->offset, img->len);
+        img->cached = 1;
+        return FR_OK;
+    }
+#endif
+
+    res = f_open(&f, path, FA_READ);
+    if (res != FR_OK) return res;
+
+    res = f_size(&f) ? build_map(&f) : FR_OK;
+    int mapped = (res == FR_OK);
+    if (res == FR_OK || res == FR_NOT_ENOUGH_CORE) {
+        res = f_read(&f, &eh, sizeof(eh), &br);
+    }
+
+    if (res == FR_OK) {
+        if (br == sizeof(eh) && eh.e_ident[0] == 0x7F && eh.e_ident[1] == 'E' &&
+            eh.e_ident[2] == 'L' && eh.e_ident[3] == 'F') {
+#ifdef CONFIG_ELF
+            res = load_elf(&f, &eh, img);
+#else
+            res = FR_INVALID_OBJECT; // Never run an ELF file as a flat image
+#endif
+        } else if (br >= sizeof(LzHeader) && eh.e_ident[0] == 'L' && eh.e_ident[1] == 'Z' &&
+                   eh.e_ident[2] == '4' && eh.e_ident[3] == 'P') {
+#ifdef CONFIG_LZ4
+            res = load_lz4(&f, img);
+#else
+            res = FR_INVALID_OBJECT;
+#endif
+        } else {
+            res = load_flat(&f, mapped, img);
+        }
+    }
+
+    f_close(&f);
+
+#ifdef CONFIG_APP_CACHE
+    if (res == FR_OK) app_cache_store(path, &fno, img);
+#endif
+    return res;
+}
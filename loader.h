@@ -0,0 +1,30 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stdint.h>
+#include "ff.h"
+
+typedef struct {
+    uint32_t entry;     // Address to jump to
+    uint32_t addr;      // RAM image: first byte written
+    uint32_t len;       // RAM image: span in bytes (including zeroed .bss)
+    UINT     size;      // Bytes placed in RAM (file or segment bytes)
+    uint8_t  cached;    // 1 if served from the RAM app cache
+} AppImage;
+
+// Load the app in 'path' into the user program area.
+// ELF32 files are placed by their PT_LOAD segments (BSS zeroed), 'LZ4P' images
+// (tools/lz4pack.py) are decompressed while they are read, and anything else
+// is treated as a flat binary for USER_PROG_ADDR. ELF and LZ4 are only built
+// with CONFIG_ELF / CONFIG_LZ4; without them such files are refused.
+// With CONFIG_APP_CACHE, images are remembered in a RAM cache keyed by path,
+// size and timestamp, so relaunching an unchanged app costs a directory lookup
+// and a memcpy.
+// Returns FR_OK on success, FR_NOT_ENOUGH_CORE if it does not fit in the user
+// area, FR_INVALID_OBJECT for an ELF or LZ4 image this kernel cannot run.
+FRESULT load_app(const char *path, AppImage *img);
+
+// Forget all cached images. Call after deleting or rewriting files.
+void app_cache_invalidate(void);
+
+#endif
@@ -1,6 +1,21 @@
 #include <stdint.h>
+#include <string.h>
 #include "ff.h" // fat32
+#include "diskio.h"
 #include "sd.h"
+#include "soc.h"
+#include "loader.h"
+#include "mount.h"
+#ifdef CONFIG_YMODEM
+#include "ymodem.h"
+#endif
+#ifdef CONFIG_HOSTLINK
+#include "hostlink.h"
+#endif
+#include "stream.h"
+#include "uart.h"
+#include "fmt.h"
+#include "commands.h"
 
 // --- Context Switching Types ---
 typedef struct {
@@ -13,14 +28,6 @@ UserContext user_ctx; // Global storage for registers
 void run_with_context(uint32_t addr, UserContext *ctx);
 void set_time(int y, int m, int d, int h, int min, int s); // Defined in diskio.c
 
-// ==========================================
-//  HARDWARE DEFINITIONS
-// ==========================================
-#define UART_DATA   (*(volatile uint32_t*)0x20000000)
-#define UART_STATUS (*(volatile uint32_t*)0x20000004)
-#define RX_READY    0x01
-#define TX_BUSY     0x02
-
 // TYPES & GLOBALS 
 // ==========================================
 
@@ -31,57 +38,19 @@ typedef struct {
 
 MonitorState state = { .current_addr = 0x10000000 };
 
-// Function Pointer Type:
-// Every command function must accept a string argument (char *args)
-// and return nothing (void).
-typedef void (*cmd_func_t)(char *args);
-
-// The Command Structure
-typedef struct {
-    const char *name;       // The command string (e.g., "peek")
-    cmd_func_t  func;       // The function to call
-    const char *help_text;  // Description for the help command
-} Command;
-
 // LOW-LEVEL DRIVERS
 // ==========================================
 
-void putc(char c) {
-    while (UART_STATUS & TX_BUSY);
-    UART_DATA = c;
-}
-
-// Non-blocking check for character
-int has_char() {
-    return (UART_STATUS & RX_READY);
-}
-
-char getc() {
-    while (!has_char());
-    return (char)UART_DATA;
-}
-
-void print(const char *str) {
-    while (*str) putc(*str++);
+// Called from irq_vec in start.S with the pending IRQ bits (q1)
+void irq_handler(uint32_t irqs) {
+    if (irqs & ((1u << IRQ_UART_RX) | (1u << IRQ_UART_TX))) uart_irq();
 }
 
 // Print a 32-bit number as Hex (0x1234ABCD)
 void print_hex(uint32_t val) {
-    print("0x");
-    for (int i = 28; i >= 0; i -= 4) {
-        uint32_t nibble = (val >> i) & 0xF;
-        putc(nibble < 10 ? '0' + nibble : 'A' + nibble - 10);
-    }
-}
-
-// Print a single byte as two hex characters
-void print_byte (uint8_t b) {
-    // top four bits MSB
-    uint8_t hn = (b >> 4) & 0x0F;
-    uint8_t ln = b & 0x0F;
-
-    putc(hn < 10 ? '0' + hn : 'A' + hn - 10);
-    putc(ln < 10 ? '0' + ln : 'A' + ln - 10);
+    char buf[10];
+    char *p = fmt_hex(fmt_str(buf, "0x"), val, 8);
+    uart_write(buf, p - buf);
 }
 
 // STRING HELPERS (No Standard Library!)
@@ -121,30 +90,53 @@ uint32_t k_atoi(char *s) {
 }
 
 // Print Integer with fixed width (e.g., print_dec(5, 2) -> "05")
-void print_dec(int val, int width) {
-    char buf[12];
-    int idx = 0;
-    if (val == 0) {
-        while (width-- > 0) putc('0');
-        return;
-    }
-    
-    // Extract digits
-    int temp = val;
-    while (temp > 0) {
-        buf[idx++] = (temp % 10) + '0';
-        temp /= 10;
+void print_dec(uint32_t val, int width) {
+    char buf[10];
+    char *p = fmt_dec(buf, val, width);
+    uart_write(buf, p - buf);
+}
+
+// Print an unsigned 64-bit number (cycle counts outgrow print_dec)
+void print_u64(uint64_t val) {
+    char buf[20];
+    char *p = fmt_u64(buf, val);
+    uart_write(buf, p - buf);
+}
+
+#if defined(CONFIG_CMD_TIME) || defined(CONFIG_PREALLOC)
+// Milliseconds without a 64-bit division. The high word is folded in with
+// 2^32 = MS_RECIP * CYCLES_PER_MS + MS_HI_R; the low word is multiplied by a
+// 32.32 reciprocal, which can come out one short, then corrected.
+#define CYCLES_PER_MS (CPU_HZ / 1000)
+#define MS_RECIP ((1ull << 32) / CYCLES_PER_MS)
+#define MS_HI_R  ((1ull << 32) % CYCLES_PER_MS)
+
+static uint64_t cycles_to_ms(uint64_t cycles) {
+    uint64_t ms = 0;
+    while (cycles >> 32) {
+        uint64_t hi = cycles >> 32;
+        ms += hi * MS_RECIP;
+        cycles = (cycles & 0xFFFFFFFF) + hi * MS_HI_R;
     }
-    
-    // Pad with leading zeros
-    while (idx < width) {
-        putc('0');
-        width--;
+    uint32_t lo = (uint32_t)cycles;
+    uint32_t q = (uint32_t)((uint64_t)lo * MS_RECIP >> 32);
+    if (lo - q * CYCLES_PER_MS >= CYCLES_PER_MS) q++;
+    return ms + q;
+}
+
+// 100 * num / den by shift-and-subtract, for ratios below 65536
+static uint32_t ratio_x100(uint64_t num, uint64_t den) {
+    uint32_t q = 0;
+    num = (num << 6) + (num << 5) + (num << 2);
+    for (int b = 15; b >= 0; b--) {
+        if ((den << b) <= num) {
+            num -= den << b;
+            q |= 1u << b;
+        }
     }
-    
-    // Print digits reversed
-    while (idx > 0) putc(buf[--idx]);
+    return q;
 }
+#endif
 
 // Import from diskio.c
 extern DWORD get_fattime(void);
@@ -154,7 +146,20 @@ extern void set_time(int y, int m, int d, int h, int min, int s);
 
 // COMMAND FUNCTIONS
 // ==========================================
-uint8_t disk_buf[512];  // buffer for SD card ops
+uint8_t disk_buf[512] KBUF __attribute__((aligned(4)));  // buffer for SD card ops
+
+// Mount on first use (see mount.c). Returns 1 if the volume is usable,
+// otherwise says why and returns 0.
+static int need_fs(void) {
+    FRESULT res = fs_ready();
+    if (res == FR_OK) return 1;
+
+    if (mount_info.state == FS_NO_CARD) print("No SD card (init failed)");
+    else if (mount_info.state == FS_NO_VOLUME) print("No FAT volume on card");
+    else print("Mount Error");
+    print(": "); print_hex(res); print("\r\n");
+    return 0;
+}
 
 void cmd_sd(char *args) {
     print("Initializing SD Card...\r\n");
@@ -179,10 +184,12 @@ void cmd_sd(char *args) {
     }
 
     // Verify Signature (Last 2 bytes of MBR should be 0x55, 0xAA)
-    print("Signature: ");
-    print_byte(disk_buf[510]);
-    print_byte(disk_buf[511]);
-    print("\r\n");
+    char line[24];
+    char *p = fmt_str(line, "Signature: ");
+    p = fmt_byte(p, disk_buf[510]);
+    p = fmt_byte(p, disk_buf[511]);
+    p = fmt_str(p, "\r\n");
+    uart_write(line, p - line);
     
     if (disk_buf[510] == 0x55 && disk_buf[511] == 0xAA) {
         print("Valid MBR found!\r\n");
@@ -191,6 +198,168 @@ void cmd_sd(char *args) {
     }
 }
 
+#ifdef CONFIG_BENCH
+// Compare per-sector CMD17 reads against one CMD18 stream over the same run,
+// then time the SPI engines (reads only; see sd_spi_bench).
+// The user program area doubles as scratch space (nothing is running).
+void cmd_sdbench(char *args) {
+    uint32_t lba = 0;
+    uint32_t count = 16;
+    char *p = args;
+
+    if (*p) {
+        lba = k_atoi(p);
+        while (*p && *p != ' ') p++;
+        if (*p) count = k_atoi(p);
+    }
+    if (count < 1 || count > 64) {
+        print("Usage: sdbench [lba] [count 1-64]\r\n");
+        return;
+    }
+
+    if (sd_init() != 0) {
+        print("Init Failed!\r\n");
+        return;
+    }
+
+    uint8_t *buf = (uint8_t*)USER_PROG_ADDR;
+
+    uint32_t t0 = rdcycle();
+    for (uint32_t i = 0; i < count; i++) {
+        if (sd_readblock(lba + i, buf + i * 512) != 0) {
+            print("CMD17 Read Failed!\r\n");
+            return;
+        }
+    }
+    uint32_t single = rdcycle() - t0;
+
+    t0 = rdcycle();
+    if (sd_readblocks(lba, buf, count) != 0) {
+        print("CMD18 Read Failed!\r\n");
+        return;
+    }
+    uint32_t multi = rdcycle() - t0;
+
+    print("Sectors: "); print_dec(count, 1); print("\r\n");
+    print("CMD17 x N : "); print_dec(single, 1);
+    print(" cycles ("); print_dec(single / count, 1); print("/sector)\r\n");
+    print("CMD18     : "); print_dec(multi, 1);
+    print(" cycles ("); print_dec(multi / count, 1); print("/sector)\r\n");
+    if (single > multi) {
+        print("Saved     : "); print_dec((single - multi) / count, 1); print(" cycles/sector\r\n");
+    }
+
+    uint32_t loop, tx, rx;
+    if (sd_spi_bench(lba, buf, &loop, &tx, &rx) != 0) {
+        print("SPI bench transfer failed!\r\n");
+        return;
+    }
+    print("SPI 512B  : spi_byte "); print_dec(loop, 1);
+    print(", tx_block "); print_dec(tx, 1);
+    print(", rx_block "); print_dec(rx, 1); print(" cycles\r\n");
+}
+
+// The old byte-at-a-time memcpy, for reference. volatile keeps GCC from
+// turning the loop back into a memcpy call.
+static void byte_copy(volatile uint8_t *d, const volatile uint8_t *s, uint32_t n) {
+    while (n--) *d++ = *s++;
+}
+
+// Cycles per call of memcpy (aligned and with the source one byte off),
+// memset and memcmp (equal buffers, the worst case) over sizes 1-4096.
+// The user program area doubles as scratch space (nothing is running).
+void cmd_membench(char *args) {
+    static const uint16_t sizes[] = { 1, 3, 8, 16, 31, 64, 128, 256, 512, 1024, 4096 };
+    uint8_t *src = (uint8_t*)USER_PROG_ADDR;
+    uint8_t *dst = src + 0x2000;
+
+    for (int i = 0; i < 0x1004; i++) src[i] = i;
+
+    print("size\tmemcpy\tsrc+1\tmemset\tmemcmp\tbyte cpy (cycles)\r\n");
+    for (uint32_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        uint32_t n = sizes[k];
+        uint32_t t0, cpy, cpy1, set, cmp, ref;
+        int same;
+
+        t0 = rdcycle(); memcpy(dst, src, n);     cpy  = rdcycle() - t0;
+        t0 = rdcycle(); memcpy(dst, src + 1, n); cpy1 = rdcycle() - t0;
+        t0 = rdcycle(); memset(dst, 0x5A, n);    set  = rdcycle() - t0;
+        memcpy(dst, src, n);
+        t0 = rdcycle(); same = memcmp(dst, src, n); cmp = rdcycle() - t0;
+        t0 = rdcycle(); byte_copy(dst, src, n);  ref  = rdcycle() - t0;
+
+        print_dec(n, 1);    putc('\t');
+        print_dec(cpy, 1);  putc('\t');
+        print_dec(cpy1, 1); putc('\t');
+        print_dec(set, 1);  putc('\t');
+        print_dec(cmp, 1);  putc('\t');
+        print_dec(ref, 1);
+        if (same != 0) print("\tmemcmp MISMATCH");
+        print("\r\n");
+    }
+}
+#endif // CONFIG_BENCH
+
+#ifdef CONFIG_IOSTAT
+// Sector cache counters (diskio.c). 'cache -r' clears them.
+void cmd_cache(char *args) {
+    DiskCacheStats *st = &disk_cache_stats;
+
+    if (k_strcmp(args, "-r") == 0) {
+        disk_cache_reset_stats();
+        print("Cache stats reset.\r\n");
+        return;
+    }
+
+    print("Geometry  : "); print_dec(st->sets, 1); print(" sets x ");
+    print_dec(st->ways, 1); print(" ways ("); print_dec(st->sets * st->ways / 2, 1); print(" KB)\r\n");
+    print("Hits      : "); print_dec(st->hits, 1); print("\r\n");
+    print("Misses    : "); print_dec(st->misses, 1); print("\r\n");
+    print("Writebacks: "); print_dec(st->writebacks, 1); print("\r\n");
+    print("Bypassed  : "); print_dec(st->bypass, 1); print(" sectors\r\n");
+    if (st->hits + st->misses) {
+        print("Hit rate  : "); print_dec(st->hits * 100 / (st->hits + st->misses), 1); print("%\r\n");
+    }
+}
+
+// Storage counters: disk_read/disk_write as FatFs sees them (diskio.c), then
+// the card itself (sd.c). 'iostat -r' clears both.
+void cmd_iostat(char *args) {
+    DiskIoStats *io = &disk_io_stats;
+    SdStats *sd = &sd_stats;
+
+    if (k_strcmp(args, "-r") == 0) {
+        disk_io_reset_stats();
+        sd_reset_stats();
+        print("I/O stats reset.\r\n");
+        return;
+    }
+
+    print("disk_read : "); print_dec(io->reads, 1); print(" calls, ");
+    print_dec(io->rd_sectors, 1); print(" sectors, "); print_u64(io->rd_cycles);
+    print(" cycles (worst "); print_u64(io->max_rd_cycles); print(")\r\n");
+    print("disk_write: "); print_dec(io->writes, 1); print(" calls, ");
+    print_dec(io->wr_sectors, 1); print(" sectors, "); print_u64(io->wr_cycles);
+    print(" cycles (worst "); print_u64(io->max_wr_cycles); print(")\r\n");
+    print("Errors    : "); print_dec(io->errors, 1); print("\r\n");
+
+    print("SD cmds   : "); print_dec(sd->cmds, 1); print(", "); print_u64(sd->cmd_cycles);
+    print(" cycles, "); print_dec(sd->r1_polls, 1); print(" R1 polls, ");
+    print_dec(sd->cmd_timeouts, 1); print(" timeouts\r\n");
+    print("SD sectors: "); print_dec(sd->rd_sectors, 1); print(" read, ");
+    print_dec(sd->wr_sectors, 1); print(" written, ");
+    print_dec(sd->wr_rejects, 1); print(" rejected\r\n");
+    print("Token wait: "); print_u64(sd->token_cycles); print(" cycles (worst ");
+    print_u64(sd->max_token_cycles); print("), ");
+    print_dec(sd->token_timeouts, 1); print(" timeouts\r\n");
+    print("Busy wait : "); print_u64(sd->busy_cycles); print(" cycles in ");
+    print_dec(sd->busy_polls, 1); print(" polls (worst "); print_u64(sd->max_busy_cycles);
+    print("), "); print_dec(sd->busy_timeouts, 1); print(" timeouts\r\n");
+    print("Worst op  : CMD17 "); print_u64(sd->max_read_cycles);
+    print(", CMD24 "); print_u64(sd->max_write_cycles); print(" cycles\r\n");
+}
+#endif // CONFIG_IOSTAT
+
 void cmd_date(char *args) {
     // print Help string
     if (k_strcmp(args, "-h") == 0 || k_strcmp(args, "--help") == 0) {
@@ -211,14 +380,16 @@ void cmd_date(char *args) {
         int min  = (t >> 5)  & 0x3F;
         int sec  = (t & 0x1F) * 2;
 
-        print("Current Time: ");
-        print_dec(year, 4); putc('-');
-        print_dec(mon, 2);  putc('-');
-        print_dec(day, 2);  putc(' ');
-        print_dec(hour, 2); putc(':');
-        print_dec(min, 2);  putc(':');
-        print_dec(sec, 2);
-        print("\r\n");
+        char line[40];
+        char *p = fmt_str(line, "Current Time: ");
+        p = fmt_dec(p, year, 4); *p++ = '-';
+        p = fmt_dec(p, mon, 2);  *p++ = '-';
+        p = fmt_dec(p, day, 2);  *p++ = ' ';
+        p = fmt_dec(p, hour, 2); *p++ = ':';
+        p = fmt_dec(p, min, 2);  *p++ = ':';
+        p = fmt_dec(p, sec, 2);
+        p = fmt_str(p, "\r\n");
+        uart_write(line, p - line);
         return;
     }
 
@@ -304,43 +475,42 @@ void cmd_poke(char *args) {
     state.current_addr = write_addr + 4;
 }
 
-#define USER_PROG_ADDR 0x10008000
-
 void cmd_exec(char *args) {
     if (!*args) {
         print("Usage: exec <filename>\r\n");
         return;
     }
 
-    FIL f;
     FRESULT res;
-    UINT bytes_read;
+    AppImage img;
+
+    if (!need_fs()) return;
 
     print("Loading "); print(args); print("...\r\n");
 
-    // 1. Open File
-    res = f_open(&f, args, FA_READ);
-    if (res != FR_OK) {
-        print("Error opening file: "); print_hex(res); print("\r\n");
+    // Contiguous extents are read with one streaming disk_read each
+    res = fs_result(load_app(args, &img));
+    if (res == FR_NOT_ENOUGH_CORE) {
+        print("File too large for user memory\r\n");
+        return;
+    }
+    if (res == FR_INVALID_OBJECT) {
+        print("Bad app image (ELF header/segment/entry or LZ4 stream),\r\n");
+        print("or ELF/LZ4 support not built in (make OPTIONS)\r\n");
         return;
     }
-
-    // We load it to a safe offset (32KB into RAM) to avoid overwriting the Kernel
-    uint8_t *load_addr = (uint8_t*)USER_PROG_ADDR;
-    
-    res = f_read(&f, load_addr, f_size(&f), &bytes_read);
-    f_close(&f);
-
     if (res != FR_OK) {
-        print("Read Error: "); print_hex(res); print("\r\n");
+        print("Load Error: "); print_hex(res); print("\r\n");
         return;
     }
 
-    print("Loaded "); print_hex(bytes_read); print(" bytes to "); print_hex(USER_PROG_ADDR); print("\r\n");
+    print("Loaded "); print_hex(img.size); print(" bytes, entry "); print_hex(img.entry);
+    if (img.cached) print(" (RAM cache)");
+    print("\r\n");
     print("Executing...\r\n");
 
     // We use the trampoline to save registers before jumping
-    run_with_context(USER_PROG_ADDR, &user_ctx);
+    run_with_context(img.entry, &user_ctx);
 
     print("Program Returned.\r\n");
 }
@@ -349,9 +519,6 @@ void cmd_cls(char *args) {
     print("\033[2J\033[H"); // ANSI Clear Screen
 }
 
-// Forward declaration for the table
-extern const Command commands[];
-
 void cmd_help(char *args) {
     print("Available Commands:\r\n");
     for (int i = 0; commands[i].name; i++) {
@@ -363,85 +530,284 @@ void cmd_help(char *args) {
     }
 }
 
-// hex dump command for the monitor
+// Format the hex and ASCII columns of one 16-byte dump row. Bytes outside
+// [first, end) are left blank so rows stay 16-byte aligned.
+static char *dump_row(char *p, const uint8_t *bytes, int first, int end) {
+    char *asc = p + 16 * 3 + 1; // ASCII column follows "XX " x 16 and '|'
+
+    for (int i = 0; i < 16; i++) {
+        uint8_t val = bytes[i];
+        if (i >= first && i < end) {
+            p = fmt_byte(p, val);
+            // 32 is Space, 126 is Tilde (~). Anything else is garbage/control codes.
+            asc[i] = (val >= 32 && val <= 126) ? val : '.';
+        } else {
+            p[0] = p[1] = ' ';
+            p += 2;
+            asc[i] = ' ';
+        }
+        *p++ = ' ';
+    }
+    *p++ = '|';
+    p += 16;
+    return fmt_str(p, "|\r\n");
+}
+
+// dump -s lba [count]: raw sectors straight from the card. This bypasses the
+// sector cache, so writes it still holds are not shown.
+static void dump_sectors(char *args) {
+    uint32_t lba = k_atoi(args);
+    uint32_t count = 1;
+
+    while (*args == ' ') args++;
+    while (*args && *args != ' ') args++;
+    if (*args) count = k_atoi(args);
+
+    for (uint32_t n = 0; n < count; n++) {
+        // The card may not have been set up yet (no mount since reset)
+        if (sd_readblock(lba + n, disk_buf) != 0 &&
+            (sd_init() != 0 || sd_readblock(lba + n, disk_buf) != 0)) {
+            print("Read Failed!\r\n");
+            return;
+        }
+
+        print("Sector "); print_dec(lba + n, 1); print(":\r\n");
+        for (int off = 0; off < 512; off += 16) {
+            char row[80];
+            char *p = fmt_str(fmt_hex(row, off, 3), ": ");
+            p = dump_row(p, disk_buf + off, 0, 16);
+            uart_write(row, p - row);
+        }
+        if (has_char()) { getc(); return; } // Any key stops
+    }
+}
+
+// hex dump command for the monitor: dump [addr] [len] (hex, default 64 bytes)
 void cmd_dump(char *args) {
+    if (args[0] == '-' && args[1] == 's') {
+        dump_sectors(args + 2);
+        return;
+    }
+
     // if args has text, use it, 
     //  otherwise, use state.current_addr.
+    uint32_t len = 64;
     if (*args) {
         state.current_addr = k_htoi(args);
+        char *p = args;
+        while (*p && *p != ' ') p++;
+        if (*p) len = k_htoi(p);
     }
 
-    // We want to print 64 bytes total, in chunks of 16.
-    for (int line = 0; line < 4; line++) {
-        
-        uint32_t row_addr = state.current_addr;
+    uint32_t addr = state.current_addr;
+    uint32_t end = addr + len;
+    if (end < addr) end = 0xFFFFFFF0; // Stop short of wrapping around
 
-        // print header: "1000000000: "
-        print_hex(row_addr);
-        print(": ");
+    // Rows start on 16-byte boundaries and each is read once, as four aligned
+    // words, then formatted into a buffer and sent with one write
+    for (uint32_t row_addr = addr & ~15u; row_addr < end; row_addr += 16) {
+        volatile uint32_t *src = (volatile uint32_t*)row_addr;
+        uint32_t words[4] = { src[0], src[1], src[2], src[3] };
 
-        // hex loop - we need to look at the next 16 bytes relative to row_addr
-        for (int i = 0; i < 16; i++) {
-            uint8_t val = *(volatile uint8_t*)(row_addr + i);
+        int first = row_addr < addr ? addr - row_addr : 0;
+        int last = end - row_addr < 16 ? end - row_addr : 16;
 
-            print_byte(val); // print "AF"
-            putc(' ');       // space between bytes
-        }
+        char row[80];
+        char *p = fmt_hex(fmt_str(row, "0x"), row_addr, 8);
+        p = fmt_str(p, ": ");
+        p = dump_row(p, (const uint8_t*)words, first, last);
+        uart_write(row, p - row);
 
-        print ("|"); // divider
+        if (has_char()) { getc(); end = row_addr + 16; break; } // Any key stops
+    }
 
-        // --- ASCII LOOP ---
-        // Read the exact same memory again to print the text representation
-        for (int i = 0; i < 16; i++) {
-            uint8_t val = *(volatile uint8_t*)(row_addr + i);
-            
-            // Check if it's printable (A-Z, 0-9, punctuation)
-            // 32 is Space, 126 is Tilde (~). Anything else is garbage/control codes.
-            if (val >= 32 && val <= 126) {
-                putc(val);
-            } else {
-                putc('.'); // Placeholder for non-printable chars
-            }
-        }
+    // Move our global state forward for the next command
+    state.current_addr = end;
+}
 
-        print("|\r\n"); // End of row
+// mount        show the mount state
+// mount -r     unmount and mount again (re-initializes the card, e.g. after
+//              swapping it; cached writes only go back to the same card)
+// mount -u     flush and unmount, e.g. before pulling the card
+void cmd_mount(char *args) {
+    if (k_strcmp(args, "-u") == 0) {
+        fs_unmount();
+        print("Unmounted.\r\n");
+        return;
+    }
+    if (k_strcmp(args, "-r") == 0) {
+        if (fs_remount() != FR_OK) {
+            need_fs(); // Report why
+            return;
+        }
+    }
 
-        // Move our global state forward by 16 bytes for the next loop (or next command)
-        state.current_addr += 16;
+    static const char *const state_names[] = { "unmounted", "no card", "no FAT volume", "mounted" };
+    print("State     : "); print(state_names[mount_info.state]); print("\r\n");
+    if (mount_info.state == FS_MOUNTED) {
+        static const char *const fs_names[] = { "?", "FAT12", "FAT16", "FAT32", "exFAT" };
+        print("Volume    : "); print(fs_names[fs.fs_type <= FS_EXFAT ? fs.fs_type : 0]);
+        print(", "); print_dec(fs.n_fatent - 2, 1); print(" clusters of ");
+        print_dec(fs.csize * 512, 1); print(" bytes\r\n");
+    }
+    print("Mounts    : "); print_dec(mount_info.mounts, 1);
+    print(", dropped on error "); print_dec(mount_info.errors, 1); print("\r\n");
+    if (mount_info.last_err) {
+        print("Last error: "); print_hex(mount_info.last_err); print("\r\n");
     }
-    
 }
 
-FATFS fs;      // Filesystem object
-FIL file;      // File object
+// The last listing stays in RAM, keyed by the directory's first cluster and
+// the mount ID. It is served again while no window sector has been written
+// back since (fs.wcnt) and none is waiting to be (fs.wflag): every directory
+// change goes through the window.
+#define LS_CACHE_MAX 256
+
+typedef struct {
+    char     name[13];
+    uint8_t  attr;
+    uint16_t date, time;
+    uint32_t size;
+} LsEntry;
+
+typedef struct {
+    uint8_t  valid;
+    WORD     id;        // fs.id when it was read
+    DWORD    sclust;    // First cluster of the directory (0: root)
+    DWORD    wcnt;      // fs.wcnt when it was read
+    uint32_t count;
+    char     path[64];  // As typed, so a repeat skips the path walk too
+} LsCache;
+
+static LsCache ls_cache;
+static LsEntry ls_ent[LS_CACHE_MAX] KBUF;
+
+// Output is built into lines here and sent in chunks
+static char ls_out[256] KBUF;
+static int ls_len;
+static uint32_t ls_files, ls_dirs;
+static uint64_t ls_bytes;
+
+static int ls_cache_fresh(void) {
+    return ls_cache.valid && ls_cache.id == fs.id && ls_cache.wcnt == fs.wcnt && !fs.wflag;
+}
 
+static void ls_flush(void) {
+    uart_write(ls_out, ls_len);
+    ls_len = 0;
+}
+
+// "drhsa  2026-01-17 12:34      12345  NAME.BIN" with -l, else the name
+static void ls_line(const LsEntry *e, int lng) {
+    char *p = ls_out + ls_len;
+
+    if (e->attr & AM_DIR) ls_dirs++;
+    else { ls_files++; ls_bytes += e->size; }
+
+    if (lng) {
+        *p++ = (e->attr & AM_DIR) ? 'd' : '-';
+        *p++ = (e->attr & AM_RDO) ? 'r' : '-';
+        *p++ = (e->attr & AM_HID) ? 'h' : '-';
+        *p++ = (e->attr & AM_SYS) ? 's' : '-';
+        *p++ = (e->attr & AM_ARC) ? 'a' : '-';
+        *p++ = ' '; *p++ = ' ';
+        p = fmt_dec(p, 1980 + (e->date >> 9), 4); *p++ = '-';
+        p = fmt_dec(p, (e->date >> 5) & 15, 2); *p++ = '-';
+        p = fmt_dec(p, e->date & 31, 2); *p++ = ' ';
+        p = fmt_dec(p, e->time >> 11, 2); *p++ = ':';
+        p = fmt_dec(p, (e->time >> 5) & 63, 2);
+        char num[10];
+        int n = fmt_dec(num, e->size, 1) - num;
+        for (int i = n; i < 12; i++) *p++ = ' ';
+        memcpy(p, num, n); p += n;
+        *p++ = ' '; *p++ = ' ';
+    }
+    p = fmt_str(p, e->name);
+    if (e->attr & AM_DIR) *p++ = '/';
+    p = fmt_str(p, "\r\n");
+
+    ls_len = p - ls_out;
+    if (ls_len > (int)sizeof(ls_out) - 64) ls_flush();
+}
+
+// ls [-l] [path]: list a directory (default /), with -l attributes, date
+// and size
 void cmd_ls(char *args) {
-    FRESULT res;
+    FRESULT res = FR_OK;
     DIR dir;
     FILINFO fno;
+    int lng = 0;
+    char *path = args;
 
-    print("Mounting...\r\n");
-    res = f_mount(&fs, "", 1); // Mount immediately
-    if (res != FR_OK) {
-        print("Mount Error: "); print_hex(res); print("\r\n");
-        return;
+    if (path[0] == '-' && path[1] == 'l' && (path[2] == ' ' || !path[2])) {
+        lng = 1;
+        path += 2;
+        while (*path == ' ') path++;
     }
+    if (!*path) path = "/";
 
-    print("Listing /\r\n");
-    res = f_opendir(&dir, "/");
-    if (res == FR_OK) {
+    if (!need_fs()) return;
+
+    print("Listing "); print(path); print("\r\n");
+    ls_len = 0; ls_files = ls_dirs = 0; ls_bytes = 0;
+
+    int cached = ls_cache_fresh() && k_strcmp(path, ls_cache.path) == 0;
+    int opened = !cached;
+    if (opened) {
+        res = fs_result(f_opendir(&dir, path));
+        if (res != FR_OK) {
+            print("OpenDir Error: "); print_hex(res); print("\r\n");
+            return;
+        }
+        cached = ls_cache_fresh() && ls_cache.sclust == dir.obj.sclust;
+    }
+
+    if (cached) {
+        for (uint32_t i = 0; i < ls_cache.count; i++) ls_line(&ls_ent[i], lng);
+    } else {
+        uint32_t count = 0;
+        ls_cache.valid = 0;
         while (1) {
-            res = f_readdir(&dir, &fno);
+            res = fs_result(f_readdir(&dir, &fno));
             if (res != FR_OK || fno.fname[0] == 0) break; // Error or End of Dir
-            
-            print(fno.fname);
-            if (fno.fattrib & AM_DIR) print("/");
-            print("\r\n");
+
+            LsEntry e;
+            memcpy(e.name, fno.fname, sizeof(e.name));
+            e.attr = fno.fattrib;
+            e.date = fno.fdate;
+            e.time = fno.ftime;
+            e.size = fno.fsize;
+            if (count < LS_CACHE_MAX) ls_ent[count] = e;
+            count++;
+            ls_line(&e, lng);
         }
-        f_closedir(&dir);
-    } else {
-        print("OpenDir Error\r\n");
+        // Keep it only if it was read whole and nothing is pending in the window
+        if (res == FR_OK && count <= LS_CACHE_MAX && !fs.wflag) {
+            ls_cache.valid = 1;
+            ls_cache.id = fs.id;
+            ls_cache.sclust = dir.obj.sclust;
+            ls_cache.wcnt = fs.wcnt;
+            ls_cache.count = count;
+        }
+    }
+    if (opened) f_closedir(&dir);
+
+    int i = 0;
+    if (ls_cache.valid) {
+        while (path[i] && i < (int)sizeof(ls_cache.path) - 1) { ls_cache.path[i] = path[i]; i++; }
+        if (path[i]) i = 0; // Too long to match on; the cluster still does
+    }
+    ls_cache.path[i] = 0;
+
+    if (lng) {
+        char *p = ls_out + ls_len;
+        p = fmt_dec(p, ls_files, 1); p = fmt_str(p, " files, ");
+        p = fmt_dec(p, ls_dirs, 1); p = fmt_str(p, " dirs, ");
+        p = fmt_u64(p, ls_bytes); p = fmt_str(p, " bytes\r\n");
+        ls_len = p - ls_out;
     }
+    ls_flush();
+    if (res != FR_OK) { print("ReadDir Error: "); print_hex(res); print("\r\n"); }
 }
 
 void cmd_unlink(char *args) {
@@ -450,9 +816,12 @@ void cmd_unlink(char *args) {
         return;
     }
 
+    if (!need_fs()) return;
+
     print("Deleting "); print(args); print("...\r\n");
 
-    FRESULT res = f_unlink(args);
+    FRESULT res = fs_result(f_unlink(args));
+    app_cache_invalidate();
 
     if (res == FR_OK) {
         print("Deleted.\r\n");
@@ -465,23 +834,428 @@ void cmd_unlink(char *args) {
     }
 }
 
+#ifdef CONFIG_PREALLOC
+// prealloc [-w] <file> <size>[K|M]: create a file as one contiguous extent.
+// With -w the size is filled through the stream writer (see stream.h) from
+// the user area, and the write rate is reported.
+void cmd_prealloc(char *args) {
+    int fill = 0;
+    char *p = args;
+
+    if (p[0] == '-' && p[1] == 'w' && (p[2] == ' ' || !p[2])) {
+        fill = 1;
+        p += 2;
+        while (*p == ' ') p++;
+    }
+    char *name = p;
+    while (*p && *p != ' ') p++;
+    if (*p) *p++ = 0;
+    uint32_t size = k_atoi(p);
+    while (*p == ' ') p++;
+    while (*p >= '0' && *p <= '9') p++;
+    int shift = 0;
+    if (*p == 'K' || *p == 'k') shift = 10;
+    if (*p == 'M' || *p == 'm') shift = 20;
+    if (size > 0xFFFFFFFFu >> shift) {
+        print("Size too large (max 4G - 1)\r\n");
+        return;
+    }
+    size <<= shift;
+
+    if (!*name || size == 0) {
+        print("Usage: prealloc [-w] <file> <size>[K|M]\r\n");
+        return;
+    }
+    if (!need_fs()) return;
+
+    FRESULT res;
+    LBA_t lba = 0;
+    uint64_t cycles = 0;
+    if (!fill) {
+        FIL fil;
+        app_cache_invalidate();
+        res = fs_result(f_open(&fil, name, FA_WRITE | FA_CREATE_ALWAYS));
+        if (res == FR_OK) {
+            res = fs_result(f_expand(&fil, size, 1));
+            lba = fs.database + (LBA_t)(fil.obj.sclust - 2) * fs.csize;
+            FRESULT cres = fs_result(f_close(&fil));
+            if (res == FR_OK) res = cres;
+            if (res != FR_OK) f_unlink(name);
+        }
+    } else {
+        res = stream_open(name, size);
+        if (res == FR_OK) {
+            const uint8_t *src = (const uint8_t*)USER_PROG_ADDR;
+            uint32_t chunk = USER_PROG_END - USER_PROG_ADDR;
+            lba = stream_sector();
+            uint64_t t0 = rdcycle64();
+            for (uint32_t left = size; left && res == FR_OK; ) {
+                uint32_t n = left < chunk ? left : chunk;
+                res = stream_write(src, n);
+                left -= n;
+            }
+            FRESULT cres = stream_close();
+            cycles = rdcycle64() - t0;
+            if (res == FR_OK) res = cres;
+        }
+    }
+
+    if (res == FR_DENIED) {
+        print("No contiguous free space of that size\r\n");
+        return;
+    }
+    if (res != FR_OK) {
+        print("Error: "); print_hex(res); print("\r\n");
+        return;
+    }
+    print(name); print(": "); print_dec(size, 1);
+    print(" bytes at LBA "); print_dec(lba, 1); print("\r\n");
+    if (fill && cycles) {
+        // KB/s = 100 * (size * 10) / (ms * 1024); ratio_x100 tops out at
+        // 65535, far above what the bit-banged card manages
+        uint64_t ms = cycles_to_ms(cycles);
+        print("Written in "); print_u64(cycles); print(" cycles");
+        if (ms) {
+            print(", "); print_dec(ratio_x100((uint64_t)size * 10, ms << 10), 1);
+            print(" KB/s");
+        }
+        print("\r\n");
+    }
+}
+#endif // CONFIG_PREALLOC
 
 
-// COMMANDS 
-// This is the "Engine" configuration. To add a command, add one line here.
-const Command commands[] = {
-    { "cls",    cmd_cls,  "Clear screen" },
-    { "date",   cmd_date, "Show or set time" },
-    { "dump",   cmd_dump, "[addr] Hex dump memory" },
-    { "exec",   cmd_exec, "<addr> Run machine code" },
-    { "help",   cmd_help, "Show this list" },
-    { "ls",     cmd_ls,   "List directory contents" },
-    { "peek",   cmd_peek, "[addr] Read memory" },
-    { "poke",   cmd_poke, "[addr] val Write memory" },
-    { "sd",     cmd_sd,   "Initialize and test SD card sector" },
-    { "unlink", cmd_unlink, "<filename> unlink a file" },
-    { 0, 0, 0 } // Sentinel (End of list marker)
-};
+#ifdef CONFIG_YMODEM
+// UPLOADS (YMODEM-1K / XMODEM-CRC, see ymodem.c)
+// ==========================================
+
+typedef struct {
+    char    path[64];   // Target file (command line or the sender's name)
+    FIL     fil;
+    FRESULT res;
+    uint8_t open;
+} RxFile;
+
+static RxFile rx_file;
+
+static int rx_file_begin(void *ctx, const char *name, uint32_t size) {
+    RxFile *rf = ctx;
+    if (!rf->path[0]) {
+        int i = 0;
+        if (name) while (name[i] && i < (int)sizeof(rf->path) - 1) { rf->path[i] = name[i]; i++; }
+        rf->path[i] = 0;
+    }
+    if (!rf->path[0]) {
+        rf->res = FR_INVALID_NAME; // XMODEM sends no name
+        return -1;
+    }
+    rf->res = fs_result(f_open(&rf->fil, rf->path, FA_WRITE | FA_CREATE_ALWAYS));
+    rf->open = rf->res == FR_OK;
+    return rf->res != FR_OK;
+}
+
+// 1K blocks keep the file offset sector aligned, so f_write sends them
+// straight to the card as two-sector writes without going through fil.buf
+static int rx_file_data(void *ctx, const uint8_t *buf, uint32_t len) {
+    RxFile *rf = ctx;
+    UINT bw;
+    rf->res = fs_result(f_write(&rf->fil, buf, len, &bw));
+    if (rf->res == FR_OK && bw != len) rf->res = FR_DENIED; // Volume full
+    return rf->res != FR_OK;
+}
+
+static void print_rx_result(int res, uint32_t bytes) {
+    static const char *const msgs[] = { "Done", "Canceled", "Timed out", "Too many errors", "Refused" };
+    uart_flush();
+    print("\r\n"); print(msgs[-res]); print(", ");
+    print_dec(bytes, 1); print(" bytes received\r\n");
+}
+
+// rx [file]: receive into a file, named by the sender if no name is given
+void cmd_rx(char *args) {
+    RxFile *rf = &rx_file;
+    YmodemSink sink = { rx_file_begin, rx_file_data, rf };
+    uint32_t bytes;
+
+    if (!need_fs()) return;
+
+    int i = 0;
+    while (args[i] && i < (int)sizeof(rf->path) - 1) { rf->path[i] = args[i]; i++; }
+    rf->path[i] = 0;
+    rf->res = FR_OK;
+    rf->open = 0;
+
+    print("Send with YMODEM-1K (or XMODEM-CRC with a file name), Ctrl-X x2 cancels\r\n");
+    int res = ymodem_receive(&sink, &bytes);
+
+    if (rf->open) {
+        FRESULT cres = fs_result(f_close(&rf->fil));
+        if (rf->res == FR_OK) rf->res = cres;
+        // Never leave half an app behind for exec to run
+        if (res != YM_OK || rf->res != FR_OK) f_unlink(rf->path);
+    }
+    app_cache_invalidate();
+
+    print_rx_result(res, bytes);
+    if (rf->res != FR_OK) {
+        print("File Error: "); print_hex(rf->res); print("\r\n");
+    } else if (res == YM_OK) {
+        print("Saved "); print(rf->path); print("\r\n");
+    }
+}
+
+static int rx_ram_begin(void *ctx, const char *name, uint32_t size) {
+    return size > USER_PROG_END - USER_PROG_ADDR;
+}
+
+static int rx_ram_data(void *ctx, const uint8_t *buf, uint32_t len) {
+    uint32_t *at = ctx;
+    if (len > USER_PROG_END - *at) return -1;
+    memcpy((void*)*at, buf, len);
+    *at += len;
+    return 0;
+}
+
+// rxrun: receive a flat binary into USER_PROG_ADDR and run it, no card needed
+void cmd_rxrun(char *args) {
+    uint32_t at = USER_PROG_ADDR;
+    YmodemSink sink = { rx_ram_begin, rx_ram_data, &at };
+    uint32_t bytes;
+
+    print("Send a flat .bin with YMODEM-1K or XMODEM-CRC, Ctrl-X x2 cancels\r\n");
+    int res = ymodem_receive(&sink, &bytes);
+    print_rx_result(res, bytes);
+    if (res == YM_SINK) print("File too large for user memory\r\n");
+    if (res != YM_OK) return;
+
+    print("Executing...\r\n");
+    run_with_context(USER_PROG_ADDR, &user_ctx);
+    print("Program Returned.\r\n");
+}
+#endif // CONFIG_YMODEM
+
+
+#ifdef CONFIG_HOSTLINK
+// HOST LINK (binary protocol for tools/hostlink.py, see hostlink.h)
+// ==========================================
+
+static void hostlink_run(uint32_t addr) {
+    run_with_context(addr, &user_ctx);
+}
+
+void cmd_hostlink(char *args) {
+    print("Host link mode (tools/hostlink.py), 'hostlink.py exit' returns\r\n");
+    uart_flush();
+    hostlink_serve(hostlink_run);
+    print("\r\nHost link closed.\r\n");
+}
+#endif // CONFIG_HOSTLINK
+
+
+// COMMAND TIMING
+// ==========================================
+// Every command run from the prompt is timed with the 64-bit cycle and
+// instret counters and kept in a small ring. 'time <cmd>' prints one
+// sample as it runs, 'time' alone dumps the ring (oldest first).
+// Built with CONFIG_CMD_TIME (make OPTIONS=CMD_TIME).
+#define CMD_HIST 16  // Must be a power of two
+
+typedef struct {
+    char     name[12];
+    uint64_t cycles;
+    uint64_t instret;
+    uint32_t sd_bytes;      // Data bytes read + written on the SD bus
+    uint32_t uart_bytes;    // Bytes queued for the UART
+} CmdTiming;
+
+CmdTiming *run_command(char *line);
+
+#ifdef CONFIG_CMD_TIME
+CmdTiming cmd_hist[CMD_HIST];
+uint32_t cmd_hist_count;    // Total commands run; next slot is count % CMD_HIST
+
+void print_timing(const CmdTiming *t) {
+    char line[160];
+    char *p = fmt_str(line, t->name);
+    while (p < line + 8) *p++ = ' ';
+    p = fmt_u64(p, t->cycles);
+    p = fmt_str(p, " cycles (");
+    p = fmt_u64(p, cycles_to_ms(t->cycles));
+    p = fmt_str(p, " ms), ");
+    p = fmt_u64(p, t->instret);
+    p = fmt_str(p, " instr, CPI ");
+    if (t->instret) {
+        // CPI x 100 as at least three digits, then a point before the last two
+        p = fmt_dec(p, ratio_x100(t->cycles, t->instret), 3);
+        p[0] = p[-1]; p[-1] = p[-2]; p[-2] = '.';
+        p++;
+    } else {
+        *p++ = '-';
+    }
+    p = fmt_str(p, ", sd ");
+    p = fmt_dec(p, t->sd_bytes, 1);
+    p = fmt_str(p, " B, uart ");
+    p = fmt_dec(p, t->uart_bytes, 1);
+    p = fmt_str(p, " B\r\n");
+    uart_write(line, p - line);
+}
+
+void cmd_time(char *args) {
+    if (*args) {
+        CmdTiming *t = run_command(args);
+        if (t) print_timing(t);
+        return;
+    }
+
+    uint32_t n = cmd_hist_count < CMD_HIST ? cmd_hist_count : CMD_HIST;
+    for (uint32_t i = cmd_hist_count - n; i != cmd_hist_count; i++) {
+        print_timing(&cmd_hist[i & (CMD_HIST - 1)]);
+    }
+}
+#endif // CONFIG_CMD_TIME
+
+
+// COMMAND LOOKUP
+// ==========================================
+// The table itself is generated from commands.def (see tools/gencmds.py).
+
+const Command *cmd_find(const char *name) {
+    uint32_t slot = cmd_hash_slot[cmd_hash(name)];
+    if (!slot) return 0;
+    const Command *c = &commands[slot - 1];
+    return k_strcmp(name, c->name) == 0 ? c : 0;
+}
+
+// Compare at most 'len' chars of a prefix with a name, like strncmp
+static int prefix_cmp(const char *prefix, const char *name, int len) {
+    for (int i = 0; i < len; i++) {
+        if (prefix[i] != name[i]) return (uint8_t)prefix[i] - (uint8_t)name[i];
+    }
+    return 0;
+}
+
+int cmd_prefix(const char *prefix, int len, int *first) {
+    // Binary search for the first name not below the prefix
+    int lo = 0, hi = cmd_count;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (prefix_cmp(prefix, commands[mid].name, len) > 0) lo = mid + 1;
+        else hi = mid;
+    }
+    *first = lo;
+
+    int n = 0;
+    while (lo + n < (int)cmd_count && prefix_cmp(prefix, commands[lo + n].name, len) == 0) n++;
+    return n;
+}
+
+// Tab completion of the command word in the line buffer. Completes as far as
+// the matches agree; if that adds nothing, lists them and redraws the line.
+// Returns the new line length.
+static int complete_line(char *buf, int idx, int max) {
+    int start = 0;
+    while (start < idx && buf[start] == ' ') start++;
+    for (int i = start; i < idx; i++) {
+        if (buf[i] == ' ') return idx; // Only the command word is completed
+    }
+
+    int first;
+    int n = cmd_prefix(buf + start, idx - start, &first);
+    if (n == 0) {
+        putc('\a');
+        return idx;
+    }
+
+    // Longest prefix shared by the first and last match (the table is sorted)
+    const char *a = commands[first].name;
+    const char *b = commands[first + n - 1].name;
+    int len = idx - start;
+    while (a[len] && a[len] == b[len]) len++;
+
+    if (len > idx - start) {
+        while (idx - start < len && idx < max) {
+            buf[idx] = a[idx - start];
+            putc(buf[idx++]);
+        }
+        if (n == 1 && idx < max) {
+            buf[idx++] = ' ';
+            putc(' ');
+        }
+        return idx;
+    }
+
+    print("\r\n");
+    for (int i = first; i < first + n; i++) {
+        print(commands[i].name); print("  ");
+    }
+    print("\r\n> ");
+    uart_write(buf, idx);
+    return idx;
+}
+
+
+// Split 'line' into command and arguments, look the command up and run it,
+// recording its timing. Returns the ring entry, or 0 if nothing ran or
+// timing is not built in. 'time' itself is not recorded; the command it
+// wraps is.
+CmdTiming *run_command(char *line) {
+    // PARSER: Separate "command" from "arguments"
+    char *cmd_str = line;
+    char *arg_str = "";
+
+    // Skip leading spaces
+    while (*cmd_str == ' ') cmd_str++;
+
+    // Find the first space after the command
+    char *p = cmd_str;
+    while (*p) {
+        if (*p == ' ') {
+            *p = 0;        // Split command from args
+            arg_str = p + 1; // Args start here
+            while (*arg_str == ' ') arg_str++; // Skip spaces before args
+            break;
+        }
+        p++;
+    }
+    if (!*cmd_str) return 0;
+
+    // Lookup in Command Table
+    const Command *cmd = cmd_find(cmd_str);
+    if (!cmd) {
+        print("Unknown command. Try 'help'.\r\n");
+        return 0;
+    }
+
+#ifdef CONFIG_CMD_TIME
+    if (cmd->func == cmd_time) {
+        cmd_time(arg_str);
+        return 0;
+    }
+
+    uint32_t sd0 = sd_bytes_read + sd_bytes_written;
+    uint32_t tx0 = uart_tx_bytes;
+    uint64_t i0 = rdinstret64();
+    uint64_t c0 = rdcycle64();
+
+    cmd->func(arg_str); // Execute function!
+
+    uint64_t c1 = rdcycle64();
+    uint64_t i1 = rdinstret64();
+
+    CmdTiming *t = &cmd_hist[cmd_hist_count++ & (CMD_HIST - 1)];
+    int n = 0;
+    while (cmd_str[n] && n < (int)sizeof(t->name) - 1) { t->name[n] = cmd_str[n]; n++; }
+    t->name[n] = 0;
+    t->cycles = c1 - c0;
+    t->instret = i1 - i0;
+    t->sd_bytes = sd_bytes_read + sd_bytes_written - sd0;
+    t->uart_bytes = uart_tx_bytes - tx0;
+    return t;
+#else
+    cmd->func(arg_str); // Execute function!
+    return 0;
+#endif
+}
 
 
 // ENTRY
@@ -490,6 +1264,7 @@ void main() {
     char buffer[64];
     int idx = 0;
 
+    uart_init();
     cmd_cls(0);
     print("=== PicoMon v1.0 ===\r\n");
     print("> ");
@@ -501,45 +1276,16 @@ void main() {
             putc('\r'); putc('\n');
             buffer[idx] = 0; // Null-terminate the string
 
-            // PARSER: Separate "command" from "arguments"
-            char *cmd_str = buffer;
-            char *arg_str = "";
-
-            // Skip leading spaces
-            while (*cmd_str == ' ') cmd_str++;
-
-            // Find the first space after the command
-            char *p = cmd_str;
-            while (*p) {
-                if (*p == ' ') {
-                    *p = 0;        // Split command from args
-                    arg_str = p + 1; // Args start here
-                    while (*arg_str == ' ') arg_str++; // Skip spaces before args
-                    break;
-                }
-                p++;
-            }
-
-            // Lookup in Command Table
-            if (*cmd_str) {
-                int found = 0;
-                for (int i = 0; commands[i].name; i++) {
-                    // Check if user input matches command name
-                    if (k_strcmp(cmd_str, commands[i].name) == 0) {
-                        commands[i].func(arg_str); // Execute function!
-                        found = 1;
-                        break;
-                    }
-                }
-                if (!found) {
-                    print("Unknown command. Try 'help'.\r\n");
-                }
-            }
+            run_command(buffer);
 
             // Reset for next command
             idx = 0;
             print("> ");
         } 
+        else if (c == '\t') { // Complete the command name
+            buffer[idx] = 0;
+            idx = complete_line(buffer, idx, 63);
+        }
         else if (c == 127 || c == 8) { // Handle Backspace
             if (idx > 0) {
                 idx--;
@@ -0,0 +1,56 @@
+#include "mount.h"
+#include "diskio.h"
+#include "loader.h"
+#include "soc.h"
+
+FATFS fs KBUF;      // The one volume (drive 0); f_mount() sets it up
+MountInfo mount_info;
+
+FRESULT fs_ready(void) {
+    if (mount_info.state == FS_MOUNTED) return FR_OK;
+
+    // Cached app images are keyed by path and timestamp only; a fresh mount
+    // may be a different card with a same-named app
+    app_cache_invalidate();
+    FRESULT res = f_mount(&fs, "", 1); // Mount immediately (runs sd_init)
+    if (res == FR_OK) {
+        mount_info.state = FS_MOUNTED;
+        mount_info.mounts++;
+        return FR_OK;
+    }
+
+    mount_info.last_err = res;
+    if (res == FR_NOT_READY || res == FR_DISK_ERR) {
+        mount_info.state = FS_NO_CARD;
+    } else if (res == FR_NO_FILESYSTEM) {
+        mount_info.state = FS_NO_VOLUME;
+    } else {
+        mount_info.state = FS_UNMOUNTED;
+    }
+    return res;
+}
+
+void fs_unmount(void) {
+    if (mount_info.state == FS_MOUNTED) disk_ioctl(0, CTRL_SYNC, 0);
+    f_unmount("");
+    app_cache_invalidate();
+    mount_info.state = FS_UNMOUNTED;
+}
+
+// No CTRL_SYNC here: the card may have been swapped, and disk_initialize()
+// writes pending sectors back only if the same card answers again
+FRESULT fs_remount(void) {
+    f_unmount("");
+    mount_info.state = FS_UNMOUNTED;
+    return fs_ready();
+}
+
+FRESULT fs_result(FRESULT res) {
+    if (res == FR_DISK_ERR || res == FR_NOT_READY || res == FR_INT_ERR) {
+        // f_mount() re-initializes the card on the next fs_ready()
+        mount_info.state = FS_UNMOUNTED;
+        mount_info.last_err = res;
+        mount_info.errors++;
+    }
+    return res;
+}
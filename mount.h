@@ -0,0 +1,40 @@
+#ifndef MOUNT_H
+#define MOUNT_H
+
+#include <stdint.h>
+#include "ff.h"
+
+// Mount manager: the volume is mounted once, on first use, and stays mounted.
+// Card initialization (sd_init) only happens on that first mount, after an
+// I/O error, or on an explicit remount.
+
+#define FS_UNMOUNTED  0     // Not tried yet, unmounted, or dropped after an error
+#define FS_NO_CARD    1     // The card did not initialize
+#define FS_NO_VOLUME  2     // The card answered but holds no FAT volume
+#define FS_MOUNTED    3
+
+typedef struct {
+    uint8_t  state;         // FS_* above
+    FRESULT  last_err;      // Last failed mount or disk-level error
+    uint32_t mounts;        // Successful mounts since boot
+    uint32_t errors;        // Mounts dropped because of disk errors
+} MountInfo;
+
+extern MountInfo mount_info;
+extern FATFS fs;
+
+// Mount if not mounted. Returns FR_OK when the volume is usable.
+FRESULT fs_ready(void);
+
+// Unmount and mount again with a fresh card initialization (after a card
+// swap). Cached writes reach the card only if it is still the same one.
+FRESULT fs_remount(void);
+
+// Write back cached sectors and unmount (before pulling the card)
+void fs_unmount(void);
+
+// Pass FatFs results through here: a disk-level error drops the mount so
+// the next fs_ready() starts over with the card. Returns 'res'.
+FRESULT fs_result(FRESULT res);
+
+#endif
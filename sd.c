@@ -1,10 +1,23 @@
+#include <string.h>
 #include "sd.h"
+#include "soc.h"
 
 #define SD_PORT   (*(volatile uint32_t*)0x30000000)
 #define PIN_SCK   1
 #define PIN_MOSI  2
 #define PIN_CS    4
 
+uint32_t sd_bytes_read;
+uint32_t sd_bytes_written;
+uint8_t sd_cid[16];
+SdStats sd_stats;
+
+#define STAT_MAX(field, v) STAT(if ((v) > sd_stats.field) sd_stats.field = (v))
+
+void sd_reset_stats(void) {
+    memset(&sd_stats, 0, sizeof(sd_stats));
+}
+
 static uint8_t spi_byte(uint8_t out) {
     uint8_t in = 0;
     for (int i = 7; i >= 0; i--) {
@@ -17,20 +30,113 @@ static uint8_t spi_byte(uint8_t out) {
     return in;
 }
 
+// Block engines for the 512-byte data phases. Every bit is unrolled and
+// branch-free: TX never samples MISO, RX never computes MOSI (it sends 0xFF).
+// MOSI is bit 1 of the port, so data bit n is moved there with a shift pair.
+#define TX_BIT(b, n, cs) do {                               \
+        uint32_t m = ((((uint32_t)(b) << 1) >> (n)) & PIN_MOSI) | (cs); \
+        SD_PORT = m;                                        \
+        SD_PORT = m | PIN_SCK;                              \
+    } while (0)
+
+#define RX_BIT(in) do {                                     \
+        SD_PORT = PIN_MOSI;                                 \
+        SD_PORT = PIN_MOSI | PIN_SCK;                       \
+        in = (in << 1) | (SD_PORT & 1);                     \
+    } while (0)
+
+// 'cs' is a constant: 0 for real transfers, PIN_CS only for sd_spi_bench()
+static inline __attribute__((always_inline))
+void spi_tx_bits(const uint8_t *buf, int len, uint32_t cs) {
+    while (len--) {
+        uint32_t b = *buf++;
+        TX_BIT(b, 7, cs); TX_BIT(b, 6, cs); TX_BIT(b, 5, cs); TX_BIT(b, 4, cs);
+        TX_BIT(b, 3, cs); TX_BIT(b, 2, cs); TX_BIT(b, 1, cs); TX_BIT(b, 0, cs);
+    }
+}
+
+static void spi_tx_block(const uint8_t *buf, int len) {
+    spi_tx_bits(buf, len, 0);
+}
+
+static void spi_rx_block(uint8_t *buf, int len) {
+    while (len--) {
+        uint32_t in = 0;
+        RX_BIT(in); RX_BIT(in); RX_BIT(in); RX_BIT(in);
+        RX_BIT(in); RX_BIT(in); RX_BIT(in); RX_BIT(in);
+        *buf++ = in;
+    }
+}
+
 static uint8_t sd_cmd(uint8_t cmd, uint32_t arg, uint8_t crc) {
+    STAT(uint32_t t0 = rdcycle());
     SD_PORT = PIN_MOSI; 
     spi_byte(0xFF);
     spi_byte(cmd | 0x40);
     spi_byte(arg >> 24); spi_byte(arg >> 16); spi_byte(arg >> 8); spi_byte(arg);
     spi_byte(crc);
+    if (cmd == 12) spi_byte(0xFF); // Skip the stuff byte after STOP_TRANSMISSION
     uint8_t r = 0xFF;
-    for (int i = 0; i < 100; i++) {
+    int i;
+    for (i = 0; i < 100; i++) {
         r = spi_byte(0xFF);
         if ((r & 0x80) == 0) break;
     }
+    STAT(sd_stats.cmds++);
+    STAT(sd_stats.r1_polls += i < 100 ? i + 1 : 100);
+    STAT(if (r & 0x80) sd_stats.cmd_timeouts++);
+    STAT(sd_stats.cmd_cycles += rdcycle() - t0);
     return r;
 }
 
+// Release CS and clock one byte so the card lets go of MISO
+static void sd_release(void) {
+    SD_PORT = PIN_CS | PIN_MOSI;
+    spi_byte(0xFF);
+}
+
+// Wait for the card to stop holding MISO low (busy). Returns 0 when ready.
+static int sd_wait_ready(int timeout) {
+    STAT(uint32_t t0 = rdcycle());
+    int polls = 1;
+    int err = 0;
+    while (spi_byte(0xFF) == 0x00) {
+        if (timeout-- <= 0) { err = -1; break; }
+        polls++;
+    }
+    STAT(uint32_t dt = rdcycle() - t0);
+    STAT(sd_stats.busy_polls += polls);
+    STAT(sd_stats.busy_cycles += dt);
+    STAT_MAX(max_busy_cycles, dt);
+    STAT(if (err) sd_stats.busy_timeouts++);
+    return err;
+}
+
+// Wait for the 0xFE token that starts each read data block. Returns 0 when seen.
+static int sd_wait_token(void) {
+    STAT(uint32_t t0 = rdcycle());
+    int timeout = 20000;
+    while (spi_byte(0xFF) != 0xFE && timeout-- > 0);
+    STAT(uint32_t dt = rdcycle() - t0);
+    STAT(sd_stats.token_cycles += dt);
+    STAT_MAX(max_token_cycles, dt);
+    if (timeout <= 0) {
+        STAT(sd_stats.token_timeouts++);
+        return -1;
+    }
+    return 0;
+}
+
+// CMD10: the card's identity, all zeros if it does not answer
+static void sd_read_cid(void) {
+    memset(sd_cid, 0, sizeof(sd_cid));
+    if (sd_cmd(10, 0, 0xFF) == 0x00 && sd_wait_token() == 0) {
+        spi_rx_block(sd_cid, sizeof(sd_cid));
+        spi_byte(0xFF); spi_byte(0xFF); // CRC
+    }
+    sd_release();
+}
+
 int sd_init(void) {
     SD_PORT = PIN_CS | PIN_MOSI;
     for (int i = 0; i < 10; i++) spi_byte(0xFF);
@@ -41,23 +147,60 @@ int sd_init(void) {
     retries = 20000;
     while (retries--) {
         sd_cmd(55, 0, 0xFF);
-        if (sd_cmd(41, 0x40000000, 0xFF) == 0x00) return 0;
+        if (sd_cmd(41, 0x40000000, 0xFF) == 0x00) {
+            sd_read_cid();
+            return 0;
+        }
     }
     return -2;
 }
 
 int sd_readblock(uint32_t lba, uint8_t *buffer) {
+    STAT(uint32_t t0 = rdcycle());
     if (sd_cmd(17, lba, 0xFF) != 0x00) return -1;
-    int timeout = 20000;
-    while (spi_byte(0xFF) != 0xFE && timeout-- > 0);
-    if (timeout <= 0) return -2;
-    for (int i = 0; i < 512; i++) *buffer++ = spi_byte(0xFF);
+    if (sd_wait_token() != 0) return -2;
+    spi_rx_block(buffer, 512);
     spi_byte(0xFF); spi_byte(0xFF);
     SD_PORT = PIN_CS | PIN_MOSI;
     spi_byte(0xFF);
+    sd_bytes_read += 512;
+    STAT(sd_stats.rd_sectors++);
+    STAT(uint32_t dt = rdcycle() - t0);
+    STAT_MAX(max_read_cycles, dt);
     return 0;
 }
 
+/*
+int sd_readblocks(uint32_t lba, uint8_t *buffer, uint32_t count);
+Sends CMD18 (Read Multiple Block) once and streams 'count' sectors back to back.
+Each sector still arrives as: Data Token (0xFE) -> 512 Bytes -> 2 CRC bytes,
+but the command frame and R1 poll are paid only once. CMD12 ends the stream.
+*/
+int sd_readblocks(uint32_t lba, uint8_t *buffer, uint32_t count) {
+    if (count == 1) return sd_readblock(lba, buffer);
+
+    if (sd_cmd(18, lba, 0xFF) != 0x00) return -1;
+
+    while (count--) {
+        if (sd_wait_token() != 0) {
+            sd_cmd(12, 0, 0xFF);
+            sd_release();
+            return -2;
+        }
+        spi_rx_block(buffer, 512);
+        buffer += 512;
+        spi_byte(0xFF); spi_byte(0xFF); // CRC
+        sd_bytes_read += 512;
+        STAT(sd_stats.rd_sectors++);
+    }
+
+    // STOP_TRANSMISSION: the card may hold busy briefly after the R1
+    int err = (sd_cmd(12, 0, 0xFF) & 0x7F) ? -3 : 0;
+    if (sd_wait_ready(20000) != 0) err = -3;
+    sd_release();
+    return err;
+}
+
 /* 
 int sd_writebock(uint32_t lba, const uint8_t *buffer);
 Sends CMD24 (Write Block). 
@@ -66,6 +209,8 @@ The protocol is strict:
                  -> Wait for "Accepted" response -> Wait for Busy signal to stop.
 */
 int sd_writeblock(uint32_t lba, const uint8_t *buffer) {
+    STAT(uint32_t t0 = rdcycle());
+
     //  Send CMD24 (Write Single Block)
     if (sd_cmd(24, lba, 0xFF) != 0x00) return -1; // Command rejected
 
@@ -74,9 +219,7 @@ int sd_writeblock(uint32_t lba, const uint8_t *buffer) {
     spi_byte(0xFE); 
 
     //  Write 512 Bytes
-    for (int i = 0; i < 512; i++) {
-        spi_byte(*buffer++);
-    }
+    spi_tx_block(buffer, 512);
 
     // Send Dummy CRC
     spi_byte(0xFF);
@@ -85,17 +228,117 @@ int sd_writeblock(uint32_t lba, const uint8_t *buffer) {
     //  Check Data Response
     // The card responds immediately. Format: xxx00101 (0x05) = Accepted
     uint8_t resp = spi_byte(0xFF);
-    if ((resp & 0x1F) != 0x05) return -2; // Write Error (CRC or Write Error)
+    if ((resp & 0x1F) != 0x05) { // Write Error (CRC or Write Error)
+        STAT(sd_stats.wr_rejects++);
+        return -2;
+    }
 
     //  Wait for Busy (Card pulls line low while writing internally)
-    int timeout = 1000000; // Writes take time!
-    while (spi_byte(0xFF) == 0x00) {
-        if (timeout-- <= 0) return -3; // Timeout
-    }
+    if (sd_wait_ready(1000000) != 0) return -3; // Writes take time!
 
     //  Cleanup
     SD_PORT = PIN_CS | PIN_MOSI; // Release CS
     spi_byte(0xFF);
+    sd_bytes_written += 512;
+    STAT(sd_stats.wr_sectors++);
+    STAT(uint32_t dt = rdcycle() - t0);
+    STAT_MAX(max_write_cycles, dt);
     
     return 0;
 }
+
+/*
+int sd_writeblocks(uint32_t lba, const uint8_t *buffer, uint32_t count);
+ACMD23 (SET_WR_BLK_ERASE_COUNT) tells the card how many blocks are coming so it
+can pre-erase them, then CMD25 (Write Multiple Block) streams them:
+    Per block: Wait ready -> Token (0xFC) -> 512 Bytes -> CRC -> Data Response
+    End:       Wait ready -> Stop Token (0xFD) -> Wait for Busy to clear
+The card programs each block while we wait for it to come ready for the next.
+*/
+int sd_writeblocks(uint32_t lba, const uint8_t *buffer, uint32_t count) {
+    if (count == 1) return sd_writeblock(lba, buffer);
+
+    // Pre-erase hint. Only a hint, so a rejection is not fatal.
+    sd_cmd(55, 0, 0xFF);
+    sd_cmd(23, count, 0xFF);
+
+    if (sd_cmd(25, lba, 0xFF) != 0x00) {
+        sd_release();
+        return -1;
+    }
+
+    spi_byte(0xFF); // One byte gap
+
+    for (uint32_t n = 0; n < count; n++) {
+        if (sd_wait_ready(1000000) != 0) {
+            sd_release();
+            return -3;
+        }
+
+        spi_byte(0xFC); // Multi-block start token
+        spi_tx_block(buffer, 512);
+        buffer += 512;
+        spi_byte(0xFF); spi_byte(0xFF); // Dummy CRC
+
+        uint8_t resp = spi_byte(0xFF);
+        if ((resp & 0x1F) != 0x05) {
+            // Rejected block: stop the stream before reporting it
+            STAT(sd_stats.wr_rejects++);
+            sd_wait_ready(1000000);
+            spi_byte(0xFD);
+            spi_byte(0xFF);
+            sd_wait_ready(1000000);
+            sd_release();
+            return -2;
+        }
+        sd_bytes_written += 512;
+        STAT(sd_stats.wr_sectors++);
+    }
+
+    //  Stop Token, then the card programs the last block
+    if (sd_wait_ready(1000000) != 0) {
+        sd_release();
+        return -3;
+    }
+    spi_byte(0xFD);
+    spi_byte(0xFF); // Busy starts one byte after the token
+    int err = sd_wait_ready(1000000) ? -3 : 0;
+
+    sd_release();
+    return err;
+}
+
+// Read 'lba' with CMD17, timing only the 512-byte data phase. engine selects
+// spi_rx_block() (1) or the spi_byte() loop (0).
+static int bench_read(uint32_t lba, uint8_t *buf, int engine, uint32_t *cycles) {
+    if (sd_cmd(17, lba, 0xFF) != 0x00) { sd_release(); return -1; }
+    if (sd_wait_token() != 0) { sd_release(); return -2; }
+
+    uint32_t t0 = rdcycle();
+    if (engine) spi_rx_block(buf, 512);
+    else for (int i = 0; i < 512; i++) buf[i] = spi_byte(0xFF);
+    *cycles = rdcycle() - t0;
+
+    spi_byte(0xFF); spi_byte(0xFF); // CRC
+    sd_release();
+    sd_bytes_read += 512;
+    return 0;
+}
+
+// Cycle cost of one 512-byte data phase through the spi_byte() loop versus the
+// block engines. Both RX paths are timed inside a real CMD17 read of 'lba'.
+// TX cost does not depend on the card, so spi_tx_block's engine is run with
+// CS held high (one more OR per bit than a real write) and nothing is written.
+int sd_spi_bench(uint32_t lba, uint8_t *scratch, uint32_t *loop_cycles, uint32_t *tx_cycles, uint32_t *rx_cycles) {
+    int err = bench_read(lba, scratch, 0, loop_cycles);
+    if (err) return err;
+    err = bench_read(lba, scratch, 1, rx_cycles);
+    if (err) return err;
+
+    SD_PORT = PIN_CS | PIN_MOSI;
+    uint32_t t0 = rdcycle();
+    spi_tx_bits(scratch, 512, PIN_CS);
+    *tx_cycles = rdcycle() - t0;
+    SD_PORT = PIN_CS | PIN_MOSI;
+    return 0;
+}
@@ -6,13 +6,68 @@
 // Initialize the SD Card. Returns 0 on success.
 int sd_init(void);
 
+// CID register of the card, read by sd_init() (all zeros if it did not answer).
+// diskio.c compares it with the CID it saw at the last disk_initialize().
+extern uint8_t sd_cid[16];
+
 // Read a single 512-byte sector.
 // lba: Logical Block Address (Sector Number)
 // buffer: Pointer to a 512-byte array
 // Returns 0 on success.
 int sd_readblock(uint32_t lba, uint8_t *buffer);
 
+// Read 'count' consecutive sectors with one CMD18 stream.
+// buffer: Pointer to count * 512 bytes
+// Returns 0 on success.
+int sd_readblocks(uint32_t lba, uint8_t *buffer, uint32_t count);
+
 // add write for unlink, etc
 int sd_writeblock(uint32_t lba, const uint8_t *buffer);
 
+// Write 'count' consecutive sectors with ACMD23 pre-erase + one CMD25 stream.
+// Returns 0 on success.
+int sd_writeblocks(uint32_t lba, const uint8_t *buffer, uint32_t count);
+
+// Data bytes moved over the SD bus by the block functions (never reset)
+extern uint32_t sd_bytes_read;
+extern uint32_t sd_bytes_written;
+
+// Card-level counters for 'iostat'. Cycle sums are split by where the time
+// goes: command overhead, waiting for read data (access time) and waiting
+// out busy after writes (programming time).
+typedef struct {
+    uint32_t cmds;              // Command frames sent
+    uint32_t r1_polls;          // Bytes clocked waiting for R1 responses
+    uint32_t cmd_timeouts;      // Commands that never answered
+    uint32_t rd_sectors;        // Sectors received (CMD17 and CMD18)
+    uint32_t wr_sectors;        // Sectors accepted (CMD24 and CMD25)
+    uint32_t token_timeouts;    // Read data tokens that never came
+    uint32_t wr_rejects;        // Write data responses other than "accepted"
+    uint32_t busy_polls;        // Bytes clocked while the card held busy
+    uint32_t busy_timeouts;
+    uint64_t cmd_cycles;        // In sd_cmd: frame out + R1 poll
+    uint64_t token_cycles;      // Waiting for read data tokens
+    uint64_t busy_cycles;       // Waiting for busy to clear
+    uint32_t max_token_cycles;  // Worst single waits
+    uint32_t max_busy_cycles;
+    uint32_t max_read_cycles;   // Worst sd_readblock / sd_writeblock, command to release
+    uint32_t max_write_cycles;
+} SdStats;
+
+extern SdStats sd_stats;
+void sd_reset_stats(void);
+
+// Bookkeeping for the 'iostat' and 'cache' counters (here and in diskio.c).
+// Only built with CONFIG_IOSTAT; without it the counters stay zero.
+#ifdef CONFIG_IOSTAT
+#define STAT(...) __VA_ARGS__
+#else
+#define STAT(...)
+#endif
+
+// Time a 512-byte data phase through the byte loop and the TX/RX block engines.
+// Reads 'lba' twice with CMD17; TX is clocked with CS high and writes nothing.
+// scratch: Pointer to a 512-byte array. Returns 0 or a negative error.
+int sd_spi_bench(uint32_t lba, uint8_t *scratch, uint32_t *loop_cycles, uint32_t *tx_cycles, uint32_t *rx_cycles);
+
 #endif
@@ -0,0 +1,45 @@
+#!/bin/bash
+# Build an SD card image for picosim the same way flash.sh lays out a card:
+# kernel.bin raw at sector 1, one FAT32 partition at sector 2048 holding the
+# apps. Needs mtools (mformat/mcopy).
+#
+#   sim/mkimg.sh [image] [size_mb]      (defaults: sd.img 64)
+
+IMG=${1:-sd.img}
+SIZE_MB=${2:-64}
+PART_START=2048
+KERNEL_BIN="kernel.bin"
+APPS_DIR="apps"
+
+if [ ! -f "$KERNEL_BIN" ]; then echo "'$KERNEL_BIN' not found, run make first."; exit 1; fi
+if ! command -v mformat > /dev/null; then echo "mtools not installed."; exit 1; fi
+
+SECTORS=$((SIZE_MB * 2048))
+PART_SECTORS=$((SECTORS - PART_START))
+if [ $((($(stat -c %s "$KERNEL_BIN" 2>/dev/null || stat -f %z "$KERNEL_BIN") + 511) / 512 + 1)) -gt $PART_START ]; then
+    echo "kernel.bin does not fit below the partition."; exit 1
+fi
+
+rm -f "$IMG"
+dd if=/dev/zero of="$IMG" bs=512 count=$SECTORS 2> /dev/null
+
+# MBR: one partition, type 0x0C (FAT32 LBA), starting at PART_START
+python3 - "$IMG" $PART_START $PART_SECTORS <<'PY'
+import struct, sys
+img, start, count = sys.argv[1], int(sys.argv[2]), int(sys.argv[3])
+entry = struct.pack('<B3sB3sII', 0x00, b'\xfe\xff\xff', 0x0C, b'\xfe\xff\xff', start, count)
+with open(img, 'r+b') as f:
+    f.seek(446); f.write(entry)
+    f.seek(510); f.write(b'\x55\xaa')
+PY
+
+dd if="$KERNEL_BIN" of="$IMG" bs=512 seek=1 conv=notrunc 2> /dev/null
+
+PART="$IMG@@$((PART_START * 512))"
+mformat -i "$PART" -F -T $PART_SECTORS -v PICOMON ::
+for f in $APPS_DIR/*.bin $APPS_DIR/*.elf $APPS_DIR/*.lzb; do
+    [ -e "$f" ] || continue
+    mcopy -i "$PART" "$f" ::
+    echo "   + $(basename "$f")"
+done
+echo "$IMG: ${SIZE_MB}MB, kernel at sector 1, FAT32 at sector $PART_START"
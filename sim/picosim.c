@@ -0,0 +1,504 @@
+/*
+   picosim - host-side PicoRV32 SoC model for benchmarking PicoMon
+
+   RV32I + the PicoRV32 IRQ extension (getq/setq/retirq/maskirq/waitirq/timer)
+   and the rdcycle/rdinstret counters, with the memory map the kernel assumes:
+
+     0x10000000  512KB SRAM
+     0x20000000  UART data      (read: RX byte, write: TX byte)
+     0x20000004  UART status    (bit 0: RX_READY, bit 1: TX_BUSY)
+     0x30000000  SD port        (write: SCK=1 MOSI=2 CS=4, read bit 0: MISO)
+
+   IRQ 3 follows RX_READY, IRQ 4 pulses when a TX byte finishes, IRQ 0 is
+   the PicoRV32 timer. Cycle counts follow the PicoRV32 README CPI table
+   (no look-ahead interface, two-stage shifter).
+
+   The kernel is booted the way the board does it: BOOT_SECTORS sectors
+   from image sector 1 are copied to 0x10000000 and run. UART RX comes from
+   stdin ('\n' becomes '\r'), TX goes to stdout; stats go to stderr.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "sdcard.h"
+
+#define RAM_BASE      0x10000000u
+#define RAM_SIZE      0x80000u
+#define UART_DATA     0x20000000u
+#define UART_STATUS   0x20000004u
+#define SD_PORT       0x30000000u
+#define BOOT_SECTORS  64            // 32KB: everything below USER_PROG_ADDR
+
+#define IRQ_TIMER     0
+#define IRQ_EBREAK    1
+#define IRQ_BUSERR    2
+#define IRQ_UART_RX   3
+#define IRQ_UART_TX   4
+
+typedef struct {
+    uint32_t x[32];
+    uint32_t pc;
+    uint32_t q[4];
+    uint32_t irq_mask;
+    uint32_t irq_pending;
+    int      irq_active;
+    uint32_t timer;
+    uint64_t cycles;
+    uint64_t instret;
+    uint64_t idle_cycles;
+} Cpu;
+
+static Cpu cpu;
+static uint8_t ram[RAM_SIZE];
+static SdCard card;
+
+static uint32_t progaddr_irq = 0x10000040;
+static uint64_t max_cycles;
+static uint64_t uart_byte_cycles;   // One 10-bit UART frame
+static volatile sig_atomic_t stop;
+static const char *halt_reason = "stopped";
+
+// UART
+static uint64_t tx_done_at;         // TX_BUSY until this cycle (0: idle)
+static uint64_t rx_next_at;         // Earliest cycle the next RX byte may land
+static int      rx_ready;
+static uint8_t  rx_data;
+static uint8_t  in_buf[256];
+static int      in_len, in_pos;
+static int      in_eof;
+static uint64_t uart_tx_bytes, uart_rx_bytes;
+static struct termios saved_tio;
+static int      tio_saved;
+
+// ==========================================
+//  UART
+// ==========================================
+
+// Pull more stdin into in_buf. 'wait' blocks until input or EOF.
+static void stdin_fill(int wait) {
+    if (in_pos < in_len || in_eof) return;
+    struct pollfd p = { .fd = 0, .events = POLLIN };
+    if (poll(&p, 1, wait ? -1 : 0) <= 0) return;
+    int n = read(0, in_buf, sizeof(in_buf));
+    if (n <= 0) {
+        in_eof = 1;
+        return;
+    }
+    in_len = n;
+    in_pos = 0;
+}
+
+static void uart_update(void) {
+    if (tx_done_at && cpu.cycles >= tx_done_at) {
+        tx_done_at = 0;
+        cpu.irq_pending |= 1u << IRQ_UART_TX;   // TX done pulse
+    }
+    if (!rx_ready && cpu.cycles >= rx_next_at) {
+        stdin_fill(0);
+        if (in_pos < in_len) {
+            rx_data = in_buf[in_pos++];
+            if (rx_data == '\n') rx_data = '\r';
+            rx_ready = 1;
+            uart_rx_bytes++;
+        }
+        rx_next_at = cpu.cycles + uart_byte_cycles;
+    }
+    if (rx_ready) cpu.irq_pending |= 1u << IRQ_UART_RX;   // Level
+}
+
+static void uart_write(uint32_t val) {
+    putchar(val & 0xFF);
+    uart_tx_bytes++;
+    tx_done_at = cpu.cycles + uart_byte_cycles;
+}
+
+// ==========================================
+//  MEMORY MAP
+// ==========================================
+
+static void fault(const char *what, uint32_t addr) {
+    static char msg[96];
+    snprintf(msg, sizeof(msg), "%s at 0x%08X (pc 0x%08X)", what, addr, cpu.pc);
+    halt_reason = msg;
+    stop = 1;
+}
+
+static uint32_t mem_read(uint32_t addr, int size) {
+    if (addr & (size - 1)) {
+        fault("misaligned load", addr);
+        return 0;
+    }
+    if (addr - RAM_BASE < RAM_SIZE) {
+        uint8_t *p = &ram[addr - RAM_BASE];
+        switch (size) {
+        case 1: return p[0];
+        case 2: return p[0] | (p[1] << 8);
+        default: return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+        }
+    }
+    switch (addr & ~3u) {
+    case UART_DATA:
+        if (rx_ready) {
+            rx_ready = 0;
+            return rx_data;
+        }
+        return 0;
+    case UART_STATUS:
+        return (rx_ready ? 1 : 0) | (tx_done_at ? 2 : 0);
+    case SD_PORT:
+        return sdc_port_read(&card);
+    }
+    fault("load from unmapped address", addr);
+    return 0;
+}
+
+static void mem_write(uint32_t addr, uint32_t val, int size) {
+    if (addr & (size - 1)) {
+        fault("misaligned store", addr);
+        return;
+    }
+    if (addr - RAM_BASE < RAM_SIZE) {
+        uint8_t *p = &ram[addr - RAM_BASE];
+        p[0] = val;
+        if (size >= 2) p[1] = val >> 8;
+        if (size == 4) { p[2] = val >> 16; p[3] = val >> 24; }
+        return;
+    }
+    switch (addr & ~3u) {
+    case UART_DATA:   uart_write(val); return;
+    case UART_STATUS: return;
+    case SD_PORT:     sdc_port_write(&card, val); return;
+    }
+    fault("store to unmapped address", addr);
+}
+
+// ==========================================
+//  CPU
+// ==========================================
+
+// EBREAK/ECALL/illegal instruction: IRQ 1 if the kernel unmasked it, else halt
+static void trap(const char *what) {
+    if (!cpu.irq_active && !(cpu.irq_mask & (1u << IRQ_EBREAK))) {
+        cpu.irq_pending |= 1u << IRQ_EBREAK;
+        cpu.pc += 4;
+        return;
+    }
+    fault(what, cpu.pc);
+}
+
+static void take_irq(void) {
+    uint32_t irqs = cpu.irq_pending & ~cpu.irq_mask;
+    cpu.q[0] = cpu.pc;
+    cpu.q[1] = irqs;
+    cpu.irq_pending &= cpu.irq_mask;
+    cpu.irq_active = 1;
+    cpu.pc = progaddr_irq;
+    cpu.cycles += 4;
+}
+
+static void tick(uint32_t n) {
+    if (cpu.timer) {
+        if (cpu.timer <= n) {
+            cpu.timer = 0;
+            cpu.irq_pending |= 1u << IRQ_TIMER;
+        } else {
+            cpu.timer -= n;
+        }
+    }
+    cpu.cycles += n;
+}
+
+// waitirq with nothing pending: jump ahead to the next device event
+static void idle_until_event(void) {
+    uint64_t next = UINT64_MAX;
+
+    if (tx_done_at) next = tx_done_at;
+    if (cpu.timer && cpu.cycles + cpu.timer < next) next = cpu.cycles + cpu.timer;
+
+    if (!rx_ready) {
+        stdin_fill(0);
+        if (in_pos >= in_len && !in_eof && next == UINT64_MAX) {
+            fflush(stdout);
+            stdin_fill(1);      // Nothing else can happen: wait for the user
+        }
+        if (in_pos < in_len) {
+            uint64_t at = rx_next_at > cpu.cycles ? rx_next_at : cpu.cycles;
+            if (at < next) next = at;
+        }
+    }
+
+    if (next == UINT64_MAX) {
+        halt_reason = "idle with no more input";
+        stop = 1;
+        return;
+    }
+    if (next > cpu.cycles) {
+        cpu.idle_cycles += next - cpu.cycles;
+        tick((uint32_t)(next - cpu.cycles));
+    }
+}
+
+static int32_t imm_i(uint32_t in) { return (int32_t)in >> 20; }
+static int32_t imm_s(uint32_t in) { return ((int32_t)(in & 0xFE000000) >> 20) | ((in >> 7) & 0x1F); }
+static int32_t imm_b(uint32_t in) {
+    return ((int32_t)(in & 0x80000000) >> 19) | ((in & 0x80) << 4) |
+           ((in >> 20) & 0x7E0) | ((in >> 7) & 0x1E);
+}
+static int32_t imm_j(uint32_t in) {
+    return ((int32_t)(in & 0x80000000) >> 11) | (in & 0xFF000) |
+           ((in >> 9) & 0x800) | ((in >> 20) & 0x7FE);
+}
+
+// Two-stage shifter: 4 bits per cycle, then single bits
+static uint32_t shift_cycles(uint32_t n) {
+    return 4 + (n >> 2) + (n & 3);
+}
+
+static void step(void) {
+    uint32_t pc = cpu.pc;
+    uint32_t in = mem_read(pc, 4);
+    if (stop) return;
+
+    uint32_t rd = (in >> 7) & 31, rs1 = (in >> 15) & 31, rs2 = (in >> 20) & 31;
+    uint32_t f3 = (in >> 12) & 7, f7 = in >> 25;
+    uint32_t a = cpu.x[rs1], b = cpu.x[rs2];
+    uint32_t res = 0, next = pc + 4, cost = 3;
+    int wb = 1;
+
+    switch (in & 0x7F) {
+    case 0x37: res = in & 0xFFFFF000; break;                    // LUI
+    case 0x17: res = pc + (in & 0xFFFFF000); break;             // AUIPC
+    case 0x6F: res = next; next = pc + imm_j(in); break;        // JAL
+    case 0x67: res = next; next = (a + imm_i(in)) & ~1u; cost = 6; break; // JALR
+    case 0x63: {                                                // Branches
+        int t;
+        wb = 0;
+        switch (f3) {
+        case 0: t = a == b; break;
+        case 1: t = a != b; break;
+        case 4: t = (int32_t)a < (int32_t)b; break;
+        case 5: t = (int32_t)a >= (int32_t)b; break;
+        case 6: t = a < b; break;
+        case 7: t = a >= b; break;
+        default: trap("illegal instruction"); return;
+        }
+        if (t) { next = pc + imm_b(in); cost = 5; }
+        break;
+    }
+    case 0x03: {                                                // Loads
+        uint32_t addr = a + imm_i(in);
+        cost = 5;
+        switch (f3) {
+        case 0: res = (int8_t)mem_read(addr, 1); break;
+        case 1: res = (int16_t)mem_read(addr, 2); break;
+        case 2: res = mem_read(addr, 4); break;
+        case 4: res = mem_read(addr, 1); break;
+        case 5: res = mem_read(addr, 2); break;
+        default: trap("illegal instruction"); return;
+        }
+        break;
+    }
+    case 0x23: {                                                // Stores
+        uint32_t addr = a + imm_s(in);
+        wb = 0;
+        cost = 5;
+        switch (f3) {
+        case 0: mem_write(addr, b, 1); break;
+        case 1: mem_write(addr, b, 2); break;
+        case 2: mem_write(addr, b, 4); break;
+        default: trap("illegal instruction"); return;
+        }
+        break;
+    }
+    case 0x13: {                                                // ALU immediate
+        int32_t imm = imm_i(in);
+        uint32_t sh = imm & 31;
+        switch (f3) {
+        case 0: res = a + imm; break;
+        case 2: res = (int32_t)a < imm; break;
+        case 3: res = a < (uint32_t)imm; break;
+        case 4: res = a ^ imm; break;
+        case 6: res = a | imm; break;
+        case 7: res = a & imm; break;
+        case 1: res = a << sh; cost = shift_cycles(sh); break;
+        case 5: res = (f7 & 0x20) ? (uint32_t)((int32_t)a >> sh) : a >> sh;
+                cost = shift_cycles(sh); break;
+        }
+        break;
+    }
+    case 0x33: {                                                // ALU register
+        if (f7 & ~0x20u) { trap("illegal instruction (M extension?)"); return; }
+        uint32_t sh = b & 31;
+        switch (f3) {
+        case 0: res = (f7 & 0x20) ? a - b : a + b; break;
+        case 1: res = a << sh; cost = shift_cycles(sh); break;
+        case 2: res = (int32_t)a < (int32_t)b; break;
+        case 3: res = a < b; break;
+        case 4: res = a ^ b; break;
+        case 5: res = (f7 & 0x20) ? (uint32_t)((int32_t)a >> sh) : a >> sh;
+                cost = shift_cycles(sh); break;
+        case 6: res = a | b; break;
+        case 7: res = a & b; break;
+        }
+        break;
+    }
+    case 0x0F: wb = 0; break;                                   // FENCE
+    case 0x73: {                                                // SYSTEM
+        uint32_t csr = in >> 20;
+        if (f3 == 0) {                  // ECALL / EBREAK
+            trap(csr ? "ebreak" : "ecall");
+            return;
+        }
+        if (f3 != 2 || rs1 != 0) { trap("unsupported csr access"); return; }
+        switch (csr) {
+        case 0xC00: case 0xC01: res = (uint32_t)cpu.cycles; break;           // cycle, time
+        case 0xC80: case 0xC81: res = (uint32_t)(cpu.cycles >> 32); break;
+        case 0xC02: res = (uint32_t)cpu.instret; break;
+        case 0xC82: res = (uint32_t)(cpu.instret >> 32); break;
+        default: trap("unsupported csr"); return;
+        }
+        cost = 4;
+        break;
+    }
+    case 0x0B:                                                  // PicoRV32 custom0
+        switch (f7) {
+        case 0: res = cpu.q[rs1 & 3]; break;                    // getq
+        case 1: cpu.q[rd & 3] = a; wb = 0; break;               // setq
+        case 2: next = cpu.q[0]; cpu.irq_active = 0; wb = 0; break; // retirq
+        case 3: res = cpu.irq_mask; cpu.irq_mask = a; break;    // maskirq
+        case 4:                                                 // waitirq
+            if (!cpu.irq_pending) {
+                idle_until_event();
+                uart_update();
+                if (!cpu.irq_pending) return;   // Re-execute until woken
+            }
+            res = cpu.irq_pending;
+            break;
+        case 5: res = cpu.timer; cpu.timer = a; break;          // timer
+        default: trap("illegal instruction"); return;
+        }
+        break;
+    default:
+        trap("illegal instruction");
+        return;
+    }
+
+    if (stop) return;
+    if (wb && rd) cpu.x[rd] = res;
+    cpu.pc = next;
+    cpu.instret++;
+    tick(cost);
+}
+
+// ==========================================
+//  MAIN
+// ==========================================
+
+static void on_signal(int sig) {
+    (void)sig;
+    halt_reason = "interrupted";
+    stop = 1;
+}
+
+static void restore_tty(void) {
+    if (tio_saved) tcsetattr(0, TCSANOW, &saved_tio);
+}
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: picosim [options] disk.img\n"
+        "  -k kernel.bin   boot this file instead of image sector 1\n"
+        "  -c cycles       stop after this many cycles\n"
+        "  -f hz           core clock (default 50000000)\n"
+        "  -b baud         UART baud rate (default 115200)\n"
+        "  -r bytes        SD read latency before each data token (default 8)\n"
+        "  -w bytes        SD busy time after each written block (default 64)\n"
+        "  -i addr         PROGADDR_IRQ (default 0x10000040)\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *kernel = 0;
+    uint64_t hz = 50000000, baud = 115200;
+    int read_latency = -1, write_busy = -1, opt;
+
+    while ((opt = getopt(argc, argv, "k:c:f:b:r:w:i:")) != -1) {
+        switch (opt) {
+        case 'k': kernel = optarg; break;
+        case 'c': max_cycles = strtoull(optarg, 0, 0); break;
+        case 'f': hz = strtoull(optarg, 0, 0); break;
+        case 'b': baud = strtoull(optarg, 0, 0); break;
+        case 'r': read_latency = atoi(optarg); break;
+        case 'w': write_busy = atoi(optarg); break;
+        case 'i': progaddr_irq = strtoul(optarg, 0, 0); break;
+        default: usage();
+        }
+    }
+    if (optind != argc - 1 || !baud) usage();
+
+    if (sdc_open(&card, argv[optind]) != 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (read_latency >= 0) card.read_latency = read_latency;
+    if (write_busy >= 0) card.write_busy = write_busy;
+    uart_byte_cycles = hz * 10 / baud;
+
+    if (kernel) {
+        FILE *f = fopen(kernel, "rb");
+        if (!f) { perror(kernel); return 1; }
+        size_t n = fread(ram, 1, RAM_SIZE, f);
+        fclose(f);
+        fprintf(stderr, "picosim: loaded %zu bytes from %s\n", n, kernel);
+    } else {
+        for (int i = 0; i < BOOT_SECTORS; i++) {
+            if (sdc_read_sector(&card, 1 + i, ram + i * 512) != 0) break;
+        }
+    }
+
+    if (isatty(0) && tcgetattr(0, &saved_tio) == 0) {
+        struct termios raw = saved_tio;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_iflag &= ~ICRNL;
+        tcsetattr(0, TCSANOW, &raw);
+        tio_saved = 1;
+        atexit(restore_tty);
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    cpu.pc = RAM_BASE;
+    cpu.irq_mask = ~0u;
+
+    while (!stop) {
+        uart_update();
+        if (!cpu.irq_active && (cpu.irq_pending & ~cpu.irq_mask)) take_irq();
+        step();
+        if (max_cycles && cpu.cycles >= max_cycles) {
+            halt_reason = "cycle limit";
+            stop = 1;
+        }
+    }
+    fflush(stdout);
+
+    uint64_t busy = cpu.cycles - cpu.idle_cycles;
+    fprintf(stderr, "\n--- picosim: %s ---\n", halt_reason);
+    fprintf(stderr, "cycles      %llu (%llu busy, %llu idle in waitirq)\n",
+            (unsigned long long)cpu.cycles, (unsigned long long)busy,
+            (unsigned long long)cpu.idle_cycles);
+    fprintf(stderr, "instret     %llu\n", (unsigned long long)cpu.instret);
+    if (cpu.instret) {
+        fprintf(stderr, "CPI         %.2f (busy cycles / instret)\n",
+                (double)busy / (double)cpu.instret);
+    }
+    fprintf(stderr, "uart        %llu bytes out, %llu bytes in\n",
+            (unsigned long long)uart_tx_bytes, (unsigned long long)uart_rx_bytes);
+    sdc_print_stats(&card, stderr);
+    sdc_close(&card);
+    return 0;
+}
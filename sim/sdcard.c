@@ -0,0 +1,281 @@
+#include <string.h>
+#include "sdcard.h"
+
+#define PIN_SCK   1
+#define PIN_MOSI  2
+#define PIN_CS    4
+
+enum {
+    ST_CMD,         // Waiting for / parsing a command frame
+    ST_READ_MULTI,  // CMD18: streaming blocks until CMD12
+    ST_WR_TOKEN,    // CMD24/CMD25: waiting for a start (or stop) token
+    ST_WR_DATA,     // Receiving a block + CRC
+};
+
+static void q_push(SdCard *c, uint8_t b) {
+    int next = (c->q_tail + 1) % SDC_QUEUE;
+    if (next == c->q_head) return;  // Full: the host is not clocking responses out
+    c->queue[c->q_tail] = b;
+    c->q_tail = next;
+}
+
+static int q_empty(SdCard *c) {
+    return c->q_head == c->q_tail;
+}
+
+static void q_clear(SdCard *c) {
+    c->q_head = c->q_tail = 0;
+}
+
+int sdc_open(SdCard *c, const char *path) {
+    memset(c, 0, sizeof(*c));
+    c->read_latency = 8;
+    c->write_busy = 64;
+    c->miso = 1;
+    c->idle = 1;
+    c->port = PIN_CS;
+
+    c->img = fopen(path, "r+b");
+    if (!c->img) {
+        c->img = fopen(path, "rb");
+        c->read_only = 1;
+    }
+    if (!c->img) return -1;
+
+    fseek(c->img, 0, SEEK_END);
+    c->nsectors = (uint32_t)(ftell(c->img) / 512);
+
+    // A different image looks like a different card
+    uint32_t psn = 2166136261u;
+    for (const char *s = path; *s; s++) psn = (psn ^ (uint8_t)*s) * 16777619u;
+    memcpy(c->cid, "\x03SDPSIM\x10", 9);    // MID, OID, PNM, PRV
+    c->cid[9] = psn >> 24; c->cid[10] = psn >> 16;
+    c->cid[11] = psn >> 8; c->cid[12] = psn;
+    c->cid[13] = 0x01; c->cid[14] = 0x5A;       // MDT
+    c->cid[15] = 0x01;                          // CRC7 not modelled, end bit
+    return 0;
+}
+
+void sdc_close(SdCard *c) {
+    if (c->img) fclose(c->img);
+    c->img = 0;
+}
+
+int sdc_read_sector(SdCard *c, uint32_t lba, uint8_t *buf) {
+    if (lba >= c->nsectors) return -1;
+    if (fseek(c->img, (long)lba * 512, SEEK_SET) != 0) return -1;
+    return fread(buf, 1, 512, c->img) == 512 ? 0 : -1;
+}
+
+static int write_sector(SdCard *c, uint32_t lba, const uint8_t *buf) {
+    if (c->read_only || lba >= c->nsectors) return -1;
+    if (fseek(c->img, (long)lba * 512, SEEK_SET) != 0) return -1;
+    return fwrite(buf, 1, 512, c->img) == 512 ? 0 : -1;
+}
+
+// Queue one read block: Nac gap, data token, 512 bytes, dummy CRC
+static void queue_block(SdCard *c, uint32_t lba) {
+    uint8_t buf[512];
+
+    for (int i = 0; i < c->read_latency; i++) q_push(c, 0xFF);
+    if (sdc_read_sector(c, lba, buf) != 0) {
+        q_push(c, 0x08);    // Data error token: out of range
+        return;
+    }
+    q_push(c, 0xFE);
+    for (int i = 0; i < 512; i++) q_push(c, buf[i]);
+    q_push(c, 0xFF); q_push(c, 0xFF);
+    c->sectors_read++;
+}
+
+static void queue_busy(SdCard *c, int n) {
+    while (n--) q_push(c, 0x00);
+}
+
+static void do_command(SdCard *c) {
+    uint8_t cmd = c->cmd[0] & 0x3F;
+    uint32_t arg = ((uint32_t)c->cmd[1] << 24) | ((uint32_t)c->cmd[2] << 16) |
+                   ((uint32_t)c->cmd[3] << 8) | c->cmd[4];
+    int app = c->app_cmd;
+
+    c->app_cmd = 0;
+    c->cmds++;
+    c->cmd_count[cmd]++;
+
+    // A new command ends whatever was being sent
+    q_clear(c);
+    if (cmd != 12) c->state = ST_CMD;
+
+    q_push(c, 0xFF);    // Ncr: one byte before the response
+    uint8_t r1 = c->idle ? 0x01 : 0x00;
+
+    if (app) {
+        switch (cmd) {
+        case 41:            // SD_SEND_OP_COND: ready on the second poll
+            if (++c->acmd41_polls >= 2) c->idle = 0;
+            q_push(c, c->idle ? 0x01 : 0x00);
+            return;
+        case 23:            // SET_WR_BLK_ERASE_COUNT: a hint, accepted
+            q_push(c, r1);
+            return;
+        }
+        // Other ACMDs fall through as standard commands
+    }
+
+    switch (cmd) {
+    case 0:                 // GO_IDLE_STATE
+        c->idle = 1;
+        c->acmd41_polls = 0;
+        q_push(c, 0x01);
+        break;
+    case 8:                 // SEND_IF_COND: R7 echoes the check pattern
+        q_push(c, r1);
+        q_push(c, 0x00); q_push(c, 0x00);
+        q_push(c, (arg >> 8) & 0x0F); q_push(c, arg & 0xFF);
+        break;
+    case 55:                // APP_CMD
+        c->app_cmd = 1;
+        q_push(c, r1);
+        break;
+    case 58:                // READ_OCR: powered up, CCS (block addressing)
+        q_push(c, r1);
+        q_push(c, 0xC0); q_push(c, 0xFF); q_push(c, 0x80); q_push(c, 0x00);
+        break;
+    case 13:                // SEND_STATUS: R2
+        q_push(c, r1); q_push(c, 0x00);
+        break;
+    case 10:                // SEND_CID: R1, then a 16-byte data block
+        q_push(c, r1);
+        q_push(c, 0xFF);
+        q_push(c, 0xFE);
+        for (int i = 0; i < 16; i++) q_push(c, c->cid[i]);
+        q_push(c, 0xFF); q_push(c, 0xFF);
+        break;
+    case 16:                // SET_BLOCKLEN
+        q_push(c, r1);
+        break;
+    case 12:                // STOP_TRANSMISSION: stuff byte, R1, short busy
+        c->state = ST_CMD;
+        q_push(c, 0xFF);
+        q_push(c, r1);
+        queue_busy(c, 2);
+        break;
+    case 17:                // READ_SINGLE_BLOCK
+    case 18:                // READ_MULTIPLE_BLOCK
+        if (c->idle || arg >= c->nsectors) {
+            q_push(c, r1 | 0x40);
+            break;
+        }
+        q_push(c, 0x00);
+        if (cmd == 17) {
+            queue_block(c, arg);
+        } else {
+            c->lba = arg;
+            c->state = ST_READ_MULTI;
+        }
+        break;
+    case 24:                // WRITE_BLOCK
+    case 25:                // WRITE_MULTIPLE_BLOCK
+        if (c->idle || arg >= c->nsectors) {
+            q_push(c, r1 | 0x40);
+            break;
+        }
+        q_push(c, 0x00);
+        c->lba = arg;
+        c->multi = (cmd == 25);
+        c->state = ST_WR_TOKEN;
+        break;
+    default:
+        q_push(c, r1 | 0x04); // Illegal command
+        break;
+    }
+}
+
+// A whole byte has been clocked in from the host
+static void byte_in(SdCard *c, uint8_t b) {
+    switch (c->state) {
+    case ST_WR_TOKEN:
+        if (b == 0xFE || (c->multi && b == 0xFC)) {
+            c->state = ST_WR_DATA;
+            c->data_len = 0;
+            return;
+        }
+        if (c->multi && b == 0xFD) {    // Stop token: program, then idle
+            c->state = ST_CMD;
+            q_clear(c);
+            q_push(c, 0xFF);
+            queue_busy(c, c->write_busy);
+            return;
+        }
+        break;  // Anything else may be a command frame
+
+    case ST_WR_DATA:
+        c->data[c->data_len++] = b;
+        if (c->data_len == 514) {
+            int ok = write_sector(c, c->lba, c->data) == 0;
+            if (ok) c->sectors_written++;
+            c->lba++;
+            q_clear(c);
+            q_push(c, ok ? 0xE5 : 0xED);    // Data response: accepted / write error
+            queue_busy(c, c->write_busy);
+            c->state = (c->multi && ok) ? ST_WR_TOKEN : ST_CMD;
+        }
+        return;
+    }
+
+    // Command framing: 01xxxxxx starts a 6-byte frame
+    if (c->cmd_len == 0 && (b & 0xC0) != 0x40) return;
+    c->cmd[c->cmd_len++] = b;
+    if (c->cmd_len == 6) {
+        c->cmd_len = 0;
+        do_command(c);
+    }
+}
+
+// Next byte to shift out on MISO
+static uint8_t byte_out(SdCard *c) {
+    if (q_empty(c) && c->state == ST_READ_MULTI) queue_block(c, c->lba++);
+    if (q_empty(c)) return 0xFF;
+    uint8_t b = c->queue[c->q_head];
+    c->q_head = (c->q_head + 1) % SDC_QUEUE;
+    return b;
+}
+
+void sdc_port_write(SdCard *c, uint32_t val) {
+    uint32_t old = c->port;
+    c->port = val;
+
+    if (val & PIN_CS) {
+        // Deselected: MISO floats high, partial bytes are dropped
+        c->miso = 1;
+        c->bitcnt = 0;
+        return;
+    }
+
+    // Rising SCK edge: sample MOSI, present the next MISO bit
+    if ((val & PIN_SCK) && !(old & PIN_SCK)) {
+        if (c->bitcnt == 0) c->out_byte = byte_out(c);
+        c->miso = (c->out_byte >> (7 - c->bitcnt)) & 1;
+        c->in_byte = (c->in_byte << 1) | ((val & PIN_MOSI) ? 1 : 0);
+        if (++c->bitcnt == 8) {
+            c->bitcnt = 0;
+            c->bytes_clocked++;
+            byte_in(c, c->in_byte);
+        }
+    }
+}
+
+uint32_t sdc_port_read(SdCard *c) {
+    return c->miso ? 1 : 0;
+}
+
+void sdc_print_stats(SdCard *c, FILE *out) {
+    fprintf(out, "sd          %llu cmds (CMD17 %llu, CMD18 %llu, CMD24 %llu, CMD25 %llu), "
+            "%llu bytes clocked\n",
+            (unsigned long long)c->cmds,
+            (unsigned long long)c->cmd_count[17], (unsigned long long)c->cmd_count[18],
+            (unsigned long long)c->cmd_count[24], (unsigned long long)c->cmd_count[25],
+            (unsigned long long)c->bytes_clocked);
+    fprintf(out, "sd sectors  %llu read, %llu written\n",
+            (unsigned long long)c->sectors_read, (unsigned long long)c->sectors_written);
+}
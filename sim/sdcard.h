@@ -0,0 +1,64 @@
+#ifndef SDCARD_H
+#define SDCARD_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// SPI-mode SD card (SDHC, block addressed) backed by a disk image file.
+// The card sees the bit-banged port exactly as sd.c drives it: one bit per
+// rising SCK edge while CS is low, MSB first in both directions.
+
+#define SDC_QUEUE 8192
+
+typedef struct {
+    FILE     *img;
+    uint32_t  nsectors;
+    int       read_only;
+
+    // Timing, in byte times on the bus
+    int       read_latency;     // 0xFF bytes before each data token (Nac)
+    int       write_busy;       // 0x00 busy bytes after each written block
+
+    // Port / bit level
+    uint32_t  port;             // Last value written to the port
+    int       miso;             // Bit presented on MISO
+    int       bitcnt;
+    uint8_t   in_byte;
+    uint8_t   out_byte;
+
+    // Byte level
+    uint8_t   queue[SDC_QUEUE]; // Bytes waiting to go out on MISO
+    int       q_head, q_tail;
+    uint8_t   cmd[6];
+    int       cmd_len;
+    int       state;
+    int       idle;             // In idle state (before ACMD41 completes)
+    int       app_cmd;          // Last command was CMD55
+    int       acmd41_polls;
+    uint32_t  lba;              // Next sector for CMD18/CMD25
+    uint8_t   data[514];        // Incoming write block + CRC
+    int       data_len;
+    int       multi;            // Current write is CMD25
+    uint8_t   cid[16];          // CMD10 register, serial number from the image path
+
+    // Statistics
+    uint64_t  cmds;
+    uint64_t  cmd_count[64];
+    uint64_t  sectors_read;
+    uint64_t  sectors_written;
+    uint64_t  bytes_clocked;
+} SdCard;
+
+int  sdc_open(SdCard *c, const char *path);
+void sdc_close(SdCard *c);
+
+// Read a raw sector from the image (used to boot the kernel). Returns 0 on success.
+int  sdc_read_sector(SdCard *c, uint32_t lba, uint8_t *buf);
+
+// CPU side of the port at 0x30000000
+void     sdc_port_write(SdCard *c, uint32_t val);
+uint32_t sdc_port_read(SdCard *c);
+
+void sdc_print_stats(SdCard *c, FILE *out);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef SOC_H
+#define SOC_H
+
+#include <stdint.h>
+
+// Memory map (see sections.lds)
+#define USER_PROG_ADDR  0x10008000  // Apps are linked and loaded here
+#define USER_PROG_END   0x10040000  // Start of .kbuf; apps must end below this
+
+// The kernel (text, data and .bss) must end below USER_PROG_ADDR, which
+// sections.lds checks: the SoC boot ROM copies 64 sectors (32KB) from sector 1
+// of the card to 0x10000000 (sim/picosim.c BOOT_SECTORS). Optional parts of
+// the kernel are left out by default to stay within that (OPTIONS in the
+// Makefile).
+
+// Large kernel buffers (caches) go in the .kbuf region of sections.lds, above
+// the user program area, so they do not push the kernel past USER_PROG_ADDR.
+// The region is NOLOAD: contents are undefined at boot.
+#define KBUF __attribute__((section(".kbuf")))
+
+// PicoRV32 performance counters (ENABLE_COUNTERS).
+// Encoded with .insn so a plain rv32i toolchain (no Zicsr) still accepts them.
+static inline uint32_t rdcycle(void) {
+    uint32_t v;
+    __asm__ volatile (".insn i 0x73, 2, %0, x0, -1024" : "=r"(v)); // csrrs v, cycle, x0
+    return v;
+}
+
+static inline uint32_t rdinstret(void) {
+    uint32_t v;
+    __asm__ volatile (".insn i 0x73, 2, %0, x0, -1022" : "=r"(v)); // csrrs v, instret, x0
+    return v;
+}
+
+// Full 64-bit counts (the low words wrap after ~85s at 50MHz). The high word
+// is read twice so a carry between the two reads is caught.
+static inline uint64_t rdcycle64(void) {
+    uint32_t hi, lo, hi2;
+    do {
+        __asm__ volatile (".insn i 0x73, 2, %0, x0, -896" : "=r"(hi));   // cycleh
+        lo = rdcycle();
+        __asm__ volatile (".insn i 0x73, 2, %0, x0, -896" : "=r"(hi2));
+    } while (hi != hi2);
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t rdinstret64(void) {
+    uint32_t hi, lo, hi2;
+    do {
+        __asm__ volatile (".insn i 0x73, 2, %0, x0, -894" : "=r"(hi));   // instreth
+        lo = rdinstret();
+        __asm__ volatile (".insn i 0x73, 2, %0, x0, -894" : "=r"(hi2));
+    } while (hi != hi2);
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Core clock, only used to turn cycle counts into wall time
+#define CPU_HZ  50000000
+
+// PicoRV32 interrupts (ENABLE_IRQ, ENABLE_IRQ_QREGS). The SoC must be built with
+// PROGADDR_IRQ = 0x10000040, where start.S places irq_vec, the UART RX ready
+// level wired to IRQ_UART_RX and a one-cycle "TX done" pulse (TX_BUSY falling)
+// to IRQ_UART_TX. Lines must not stay high while idle: waitirq wakes on any
+// pending IRQ, masked or not.
+#define IRQ_UART_RX       3
+#define IRQ_UART_TX       4
+#define IRQ_ENABLED_MASK  (~((1u << IRQ_UART_RX) | (1u << IRQ_UART_TX)))   // maskirq: 1 = masked
+
+// maskirq: install a new mask, return the previous one
+static inline uint32_t irq_setmask(uint32_t mask) {
+    uint32_t old;
+    __asm__ volatile (".insn r 0x0B, 6, 3, %0, %1, x0" : "=r"(old) : "r"(mask) : "memory");
+    return old;
+}
+
+// waitirq: stall until any IRQ is pending (masked or not), return the pending bits
+static inline uint32_t irq_wait(void) {
+    uint32_t pending;
+    __asm__ volatile (".insn r 0x0B, 4, 4, %0, x0, x0" : "=r"(pending) : : "memory");
+    return pending;
+}
+
+#endif
@@ -2,23 +2,110 @@
 #include <stddef.h>
 
 // --- Memory Functions ---
+// Word-at-a-time with 8x unrolled main loops (PicoRV32 has no cache, so the
+// cost is instructions: one lw/sw per 4 bytes instead of per byte), a byte
+// head to reach alignment and a byte tail. Misaligned accesses trap, so a
+// source that cannot be aligned together with the destination is read as
+// aligned words and shifted into place.
+//
+// GCC turns byte loops like these into calls to memset/memcpy themselves,
+// which would recurse; NO_LIBCALL keeps it from doing that here.
+#define NO_LIBCALL __attribute__((optimize("no-tree-loop-distribute-patterns")))
 
-void *memset(void *dst, int c, size_t n) {
+NO_LIBCALL void *memset(void *dst, int c, size_t n) {
     uint8_t *d = (uint8_t *)dst;
+
+    if (n >= 8) {
+        uint32_t w = (uint8_t)c;
+        w |= w << 8;
+        w |= w << 16;
+
+        while ((uintptr_t)d & 3) { *d++ = c; n--; }
+
+        uint32_t *dw = (uint32_t *)d;
+        for (; n >= 32; n -= 32, dw += 8) {
+            dw[0] = w; dw[1] = w; dw[2] = w; dw[3] = w;
+            dw[4] = w; dw[5] = w; dw[6] = w; dw[7] = w;
+        }
+        for (; n >= 4; n -= 4) *dw++ = w;
+        d = (uint8_t *)dw;
+    }
+
     while (n--) *d++ = c;
     return dst;
 }
 
-void *memcpy(void *dst, const void *src, size_t n) {
+NO_LIBCALL void *memcpy(void *dst, const void *src, size_t n) {
     uint8_t *d = (uint8_t *)dst;
     const uint8_t *s = (const uint8_t *)src;
+
+    if (n >= 8) {
+        while ((uintptr_t)d & 3) { *d++ = *s++; n--; }
+
+        uint32_t *dw = (uint32_t *)d;
+        uint32_t off = (uintptr_t)s & 3;
+
+        if (off == 0) {
+            const uint32_t *sw = (const uint32_t *)s;
+            for (; n >= 32; n -= 32, dw += 8, sw += 8) {
+                uint32_t a = sw[0], b = sw[1], c = sw[2], e = sw[3];
+                dw[0] = a; dw[1] = b; dw[2] = c; dw[3] = e;
+                a = sw[4]; b = sw[5]; c = sw[6]; e = sw[7];
+                dw[4] = a; dw[5] = b; dw[6] = c; dw[7] = e;
+            }
+            for (; n >= 4; n -= 4) *dw++ = *sw++;
+            s = (const uint8_t *)sw;
+        } else {
+            // Little-endian merge: each output word is the top of one
+            // aligned source word and the bottom of the next. The last load
+            // never leaves the word holding the last byte we need.
+            const uint32_t *sw = (const uint32_t *)(s - off);
+            uint32_t lo = off * 8, hi = 32 - lo;
+            uint32_t w0 = *sw++;
+            for (; n >= 16; n -= 16, dw += 4, sw += 4) {
+                uint32_t w1 = sw[0], w2 = sw[1], w3 = sw[2], w4 = sw[3];
+                dw[0] = (w0 >> lo) | (w1 << hi);
+                dw[1] = (w1 >> lo) | (w2 << hi);
+                dw[2] = (w2 >> lo) | (w3 << hi);
+                dw[3] = (w3 >> lo) | (w4 << hi);
+                w0 = w4;
+            }
+            for (; n >= 4; n -= 4) {
+                uint32_t w1 = *sw++;
+                *dw++ = (w0 >> lo) | (w1 << hi);
+                w0 = w1;
+            }
+            s = (const uint8_t *)sw - 4 + off;
+        }
+        d = (uint8_t *)dw;
+    }
+
     while (n--) *d++ = *s++;
     return dst;
 }
 
-int memcmp(const void *s1, const void *s2, size_t n) {
+NO_LIBCALL int memcmp(const void *s1, const void *s2, size_t n) {
     const uint8_t *p1 = (const uint8_t *)s1;
     const uint8_t *p2 = (const uint8_t *)s2;
+
+    // Skip equal words; the byte loop below then finds the first difference
+    if (n >= 8 && (((uintptr_t)p1 ^ (uintptr_t)p2) & 3) == 0) {
+        while ((uintptr_t)p1 & 3) {
+            if (*p1 != *p2) return *p1 - *p2;
+            p1++; p2++; n--;
+        }
+        const uint32_t *w1 = (const uint32_t *)p1;
+        const uint32_t *w2 = (const uint32_t *)p2;
+        for (; n >= 16; n -= 16, w1 += 4, w2 += 4) {
+            if ((w1[0] ^ w2[0]) | (w1[1] ^ w2[1]) | (w1[2] ^ w2[2]) | (w1[3] ^ w2[3])) break;
+        }
+        for (; n >= 4; n -= 4, w1++, w2++) {
+            if (*w1 != *w2) break;
+        }
+        p1 = (const uint8_t *)w1;
+        p2 = (const uint8_t *)w2;
+    }
+
     while (n--) {
         if (*p1 != *p2) return *p1 - *p2;
         p1++; p2++;
@@ -0,0 +1,124 @@
+#include <string.h>
+#include "stream.h"
+#include "diskio.h"
+#include "mount.h"
+#include "loader.h"
+#include "soc.h"
+
+// Staging buffer for writes smaller than a run of sectors. It goes out as
+// one CMD25 stream when full; larger writes go straight from the caller.
+#define STREAM_BUF_SECTORS  16
+
+typedef struct {
+    FIL      fil;
+    LBA_t    sect;      // First sector of the extent
+    uint32_t size;      // Extent size in bytes
+    uint32_t written;   // Bytes accepted by stream_write()
+    uint32_t flushed;   // Bytes on the card (whole sectors until close)
+    uint32_t fill;      // Bytes waiting in stage[]
+} Stream;
+
+static Stream st KBUF;      // Only meaningful while st_open is set
+static uint8_t st_open;
+static uint8_t stage[STREAM_BUF_SECTORS * 512] KBUF;
+
+// Write whole sectors at the current end of the stream
+static FRESULT put_sectors(const uint8_t *buf, uint32_t count) {
+    if (disk_write(0, buf, st.sect + (st.flushed >> 9), count) != RES_OK) return FR_DISK_ERR;
+    st.flushed += count << 9;
+    return FR_OK;
+}
+
+int stream_open(const char *path, uint32_t size) {
+    if (st_open) stream_close();
+    if (size == 0) return FR_INVALID_PARAMETER;
+
+    FRESULT res = fs_ready();
+    if (res != FR_OK) return res;
+
+    app_cache_invalidate();
+    res = fs_result(f_open(&st.fil, path, FA_WRITE | FA_CREATE_ALWAYS));
+    if (res != FR_OK) return res;
+
+    // Allocate the extent and put it on the card before any data, so a
+    // capture cut short by a reset still has its sectors in the file
+    res = f_expand(&st.fil, size, 1);
+    if (res == FR_OK) res = f_sync(&st.fil);
+    if (res != FR_OK) {
+        f_close(&st.fil);
+        f_unlink(path);
+        return fs_result(res);
+    }
+
+    FATFS *vol = st.fil.obj.fs;
+    st.sect = vol->database + (LBA_t)(st.fil.obj.sclust - 2) * vol->csize;
+    st.size = size;
+    st.written = 0;
+    st.flushed = 0;
+    st.fill = 0;
+    st_open = 1;
+    return FR_OK;
+}
+
+int stream_write(const void *buf, uint32_t len) {
+    const uint8_t *p = buf;
+    FRESULT res = FR_OK;
+
+    if (!st_open) return FR_INVALID_OBJECT;
+    if (len > st.size - st.written) return FR_DENIED;
+    st.written += len;
+
+    // Top up a partly filled stage first
+    if (st.fill) {
+        uint32_t n = sizeof(stage) - st.fill;
+        if (n > len) n = len;
+        memcpy(stage + st.fill, p, n);
+        st.fill += n;
+        p += n;
+        len -= n;
+        if (st.fill < sizeof(stage)) return FR_OK;
+        res = put_sectors(stage, STREAM_BUF_SECTORS);
+        st.fill = 0;
+        if (res != FR_OK) return fs_result(res);
+    }
+
+    // The stage is empty here: big writes skip the copy
+    if (len >= sizeof(stage)) {
+        uint32_t n = len & ~511u;
+        res = put_sectors(p, n >> 9);
+        if (res != FR_OK) return fs_result(res);
+        p += n;
+        len -= n;
+    }
+
+    memcpy(stage, p, len);
+    st.fill = len;
+    return FR_OK;
+}
+
+int stream_close(void) {
+    FRESULT res = FR_OK;
+
+    if (!st_open) return FR_INVALID_OBJECT;
+    st_open = 0;
+
+    // Pad the last sector; the file size cuts the padding off again
+    if (st.fill) {
+        uint32_t count = (st.fill + 511) >> 9;
+        memset(stage + st.fill, 0, (count << 9) - st.fill);
+        res = put_sectors(stage, count);
+        st.fill = 0;
+    }
+
+    // Give the clusters past the data back to the volume
+    FRESULT r = f_lseek(&st.fil, st.written);
+    if (r == FR_OK) r = f_truncate(&st.fil);
+    if (res == FR_OK) res = r;
+    r = f_close(&st.fil);
+    if (res == FR_OK) res = r;
+    return fs_result(res);
+}
+
+LBA_t stream_sector(void) {
+    return st_open ? st.sect : 0;
+}
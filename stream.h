@@ -0,0 +1,30 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include "ff.h"
+
+// Contiguous capture files (one open at a time, also exported to apps through
+// the jump table). stream_open() preallocates the file as one extent of
+// clusters with f_expand() and records it on the card right away.
+// stream_write() then goes straight to the extent's sectors with multi-sector
+// disk_write() calls: no cluster allocation, FAT or directory updates while
+// capturing. stream_close() sets the size to the bytes written and frees the
+// unused end of the extent.
+// All three return an FRESULT.
+
+// Create 'path' (replacing it) with 'size' bytes of contiguous space.
+// FR_DENIED if the volume has no free run that long.
+int stream_open(const char *path, uint32_t size);
+
+// Append 'len' bytes. FR_DENIED (nothing written) if they would not fit in
+// the extent.
+int stream_write(const void *buf, uint32_t len);
+
+// Write out the buffered tail, trim the file and close it
+int stream_close(void);
+
+// Where the open stream lives on the card, for reporting. 0 if none is open.
+LBA_t stream_sector(void);
+
+#endif
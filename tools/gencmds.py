@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Generate the shell command table (cmdtab.c) from commands.def.
+
+Each line of commands.def is: name function option help text...
+Blank lines and lines starting with '#' are ignored. 'option' is '-' for a
+command that is always built, else the build option (Makefile OPTIONS) the
+command needs; it is left out of the table unless that option is given.
+
+The output has:
+    commands[]       entries sorted by name (help order, prefix search)
+    cmd_hash_slot[]  perfect hash: slot -> index + 1 (0 = empty)
+    CMD_HASH_SEED    seed for which no two names share a slot
+
+The hash must match cmd_hash() in commands.h. RV32I has no multiplier, so it
+is h = h * 33 ^ c with the multiply done as a shift and add.
+
+Usage: gencmds.py commands.def cmdtab.c [OPTION ...]
+"""
+import re
+import sys
+
+MAX_SEED = 1 << 16
+
+
+def cmd_hash(name, seed, size):
+    h = seed
+    for ch in name.encode():
+        h = (((h << 5) + h) & 0xFFFFFFFF) ^ ch
+    return (h ^ (h >> 11)) & (size - 1)
+
+
+def find_seed(names):
+    # Smallest power-of-two table, at least twice the entries, with a seed
+    # that spreads every name to its own slot
+    size = 8
+    while size < 2 * len(names):
+        size *= 2
+    while True:
+        for seed in range(MAX_SEED):
+            if len({cmd_hash(n, seed, size) for n in names}) == len(names):
+                return seed, size
+        size *= 2
+
+
+def c_string(s):
+    return '"' + s.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+    options = set(sys.argv[3:])
+
+    cmds = []
+    for lineno, line in enumerate(open(sys.argv[1]), 1):
+        line = line.strip()
+        if not line or line.startswith('#'):
+            continue
+        parts = line.split(None, 3)
+        if len(parts) < 3:
+            sys.exit('%s:%d: expected "name function option help"' % (sys.argv[1], lineno))
+        name, func, option = parts[0], parts[1], parts[2]
+        if not re.match(r'^[A-Za-z_][A-Za-z0-9_]*$', func):
+            sys.exit('%s:%d: bad function name %r' % (sys.argv[1], lineno, func))
+        if not re.match(r'^(-|[A-Z][A-Z0-9_]*)$', option):
+            sys.exit('%s:%d: bad option %r' % (sys.argv[1], lineno, option))
+        if any(c[0] == name for c in cmds):
+            sys.exit('%s:%d: duplicate command %r' % (sys.argv[1], lineno, name))
+        if option != '-' and option not in options:
+            continue
+        cmds.append((name, func, parts[3] if len(parts) > 3 else ''))
+
+    cmds.sort()
+    names = [c[0] for c in cmds]
+    if len(cmds) > 255:
+        sys.exit('too many commands for 8-bit hash slots')
+    seed, size = find_seed(names)
+
+    slots = [0] * size
+    for i, n in enumerate(names):
+        slots[cmd_hash(n, seed, size)] = i + 1
+
+    out = []
+    out.append('// Generated by tools/gencmds.py from %s - do not edit' % sys.argv[1])
+    out.append('#include "commands.h"')
+    out.append('')
+    for func in sorted({c[1] for c in cmds}):
+        out.append('void %s(char *args);' % func)
+    out.append('')
+    out.append('const uint32_t cmd_count = %d;' % len(cmds))
+    out.append('const uint32_t cmd_hash_seed = %du;' % seed)
+    out.append('const uint32_t cmd_hash_mask = %d;' % (size - 1))
+    out.append('')
+    out.append('// Sorted by name')
+    out.append('const Command commands[] = {')
+    for name, func, help_text in cmds:
+        out.append('    { %s, %s, %s },' % (c_string(name), func, c_string(help_text)))
+    out.append('    { 0, 0, 0 } // Sentinel (End of list marker)')
+    out.append('};')
+    out.append('')
+    out.append('// cmd_hash(name) -> index into commands[] + 1, 0 if no command')
+    out.append('const uint8_t cmd_hash_slot[%d] = {' % size)
+    for i in range(0, size, 16):
+        out.append('    ' + ', '.join('%d' % s for s in slots[i:i + 16]) + ',')
+    out.append('};')
+    out.append('')
+
+    with open(sys.argv[2], 'w') as f:
+        f.write('\n'.join(out))
+
+
+if __name__ == '__main__':
+    main()
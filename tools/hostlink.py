@@ -0,0 +1,374 @@
+#!/usr/bin/env python3
+"""Host side of the PicoMon binary host link (hostlink.h).
+
+Puts the shell into 'hostlink' mode if it is not there yet, then runs one
+action. Frames are COBS encoded between 0x00 delimiters and carry a
+CRC-16/XMODEM; lost or damaged replies are retried with the same sequence
+number, which the board answers without running the request twice.
+
+Usage: hostlink.py [-p port] [-b baud] [--exec cmd] action [args]
+    ping                        check the link, print the protocol version
+    read ADDR LEN [FILE]        memory to FILE (hex dump if no FILE)
+    write ADDR FILE             FILE to memory, verified by CRC
+    crc ADDR LEN                CRC-16 of a memory range
+    sread LBA COUNT FILE        raw SD sectors to FILE
+    swrite LBA FILE             FILE to raw SD sectors (padded to 512)
+    put LOCAL [REMOTE]          copy a file to the card
+    get REMOTE [LOCAL]          copy a file from the card
+    run FILE [ADDR]             load a flat .bin (default 0x10008000) and run it
+    jump ADDR                   run code already in memory
+    exit                        back to the shell prompt
+
+The port defaults to $PICOMON_PORT or /dev/ttyUSB0. --exec talks to a
+command's stdin/stdout instead, e.g. --exec 'sim/picosim sd.img'.
+"""
+import argparse
+import binascii
+import os
+import select
+import shlex
+import struct
+import subprocess
+import sys
+import time
+
+# Opcodes and status codes, as in hostlink.h
+PING, MEM_READ, MEM_WRITE, MEM_CRC = 0x01, 0x02, 0x03, 0x04
+SECT_READ, SECT_WRITE = 0x05, 0x06
+FILE_OPEN, FILE_READ, FILE_WRITE, FILE_CLOSE = 0x07, 0x08, 0x09, 0x0A
+JUMP, EXIT = 0x0B, 0x0C
+
+OK, RETURNED, BAD_OP, BAD_ARG, DISK, FS = range(6)
+STATUS = {BAD_OP: 'unknown opcode', BAD_ARG: 'bad argument',
+          DISK: 'SD card error', FS: 'FatFs error'}
+
+MAX_DATA = 1024
+USER_PROG_ADDR = 0x10008000
+
+
+def crc16(data):
+    return binascii.crc_hqx(data, 0)
+
+
+def cobs_encode(data):
+    out = bytearray()
+    for block in data.split(b'\0'):
+        while len(block) >= 254:
+            out.append(255)
+            out += block[:254]
+            block = block[254:]
+        out.append(len(block) + 1)
+        out += block
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 255 and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class LinkError(Exception):
+    pass
+
+
+class Port:
+    """A serial port, or the stdin/stdout of a child process."""
+
+    def __init__(self, port, baud, cmd):
+        self.proc = None
+        if cmd:
+            self.proc = subprocess.Popen(shlex.split(cmd), stdin=subprocess.PIPE,
+                                         stdout=subprocess.PIPE, bufsize=0)
+            self.rfd = self.proc.stdout.fileno()
+            self.wfd = self.proc.stdin.fileno()
+            return
+        import termios
+        fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+        attrs = termios.tcgetattr(fd)
+        speed = getattr(termios, 'B%d' % baud)
+        attrs[0] = 0                                        # iflag: raw
+        attrs[1] = 0                                        # oflag
+        attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        attrs[3] = 0                                        # lflag
+        attrs[4] = attrs[5] = speed
+        attrs[6][termios.VMIN] = 0
+        attrs[6][termios.VTIME] = 0
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+        termios.tcflush(fd, termios.TCIOFLUSH)
+        self.rfd = self.wfd = fd
+
+    def write(self, data):
+        while data:
+            n = os.write(self.wfd, data)
+            data = data[n:]
+
+    def read(self, timeout):
+        r, _, _ = select.select([self.rfd], [], [], max(timeout, 0))
+        if not r:
+            return b''
+        data = os.read(self.rfd, 4096)
+        if not data:
+            raise LinkError('port closed')
+        return data
+
+
+class Link:
+    def __init__(self, port):
+        self.port = port
+        self.seq = 0
+        self.rx = bytearray()
+        self.queue = []         # Frames decoded but not yet handed out
+        self.in_frame = True
+
+    def send(self, op, payload=b''):
+        frame = bytes([op, self.seq]) + payload
+        frame += struct.pack('>H', crc16(frame))
+        self.port.write(b'\0' + cobs_encode(frame) + b'\0')
+
+    def frames(self, timeout, junk=None):
+        """Yield decoded frames with a good CRC until 'timeout' passes.
+        With junk(), bytes outside frames (program output) are passed to it."""
+        end = time.time() + timeout
+        while True:
+            while self.queue:
+                yield self.queue.pop(0)
+            left = end - time.time()
+            if left <= 0:
+                return
+            data = self.port.read(min(left, 0.2) if junk else left)
+            if not data:
+                # A zero byte in program output: stop waiting for a frame end
+                if junk and self.rx:
+                    junk(bytes(self.rx))
+                    self.rx.clear()
+                    self.in_frame = False
+                continue
+            for i, seg in enumerate(data.split(b'\0')):
+                if i:
+                    frame = self.finish(junk)
+                    if frame:
+                        self.queue.append(frame)
+                    self.in_frame = True
+                if self.in_frame or not junk:
+                    self.rx += seg
+                else:
+                    junk(seg)
+
+    def finish(self, junk):
+        raw = bytes(self.rx)
+        self.rx.clear()
+        if not raw:
+            return None
+        frame = cobs_decode(raw)
+        if frame and len(frame) >= 5 and crc16(frame[:-2]) == struct.unpack('>H', frame[-2:])[0]:
+            return frame[:-2]
+        if junk:
+            junk(raw)
+        return None
+
+    def request(self, op, payload=b'', timeout=2.0, retries=5):
+        self.seq = (self.seq + 1) & 0xFF
+        for _ in range(retries):
+            self.send(op, payload)
+            for frame in self.frames(timeout):
+                if frame[0] == op | 0x80 and frame[1] == self.seq:
+                    return frame[2], frame[3:]
+        raise LinkError('no reply to opcode 0x%02x' % op)
+
+    def call(self, op, payload=b'', **kw):
+        status, data = self.request(op, payload, **kw)
+        if status == FS:
+            raise LinkError('FatFs error %d' % data[0])
+        if status not in (OK, RETURNED):
+            raise LinkError(STATUS.get(status, 'status %d' % status))
+        return data
+
+    def enter(self):
+        """Reach host link mode: ping first, type 'hostlink' at the shell if
+        nothing answers. In host link mode the typed text is just noise."""
+        for attempt in range(3):
+            try:
+                data = self.call(PING, timeout=0.5, retries=2)
+                if data[:4] != b'PMON':
+                    raise LinkError('unexpected ping reply %r' % data)
+                return data[4], struct.unpack('<H', data[5:7])[0]
+            except LinkError:
+                self.port.write(b'\rhostlink\r')
+        raise LinkError('board does not answer')
+
+    # Operations
+
+    def mem_read(self, addr, length):
+        out = bytearray()
+        while len(out) < length:
+            n = min(MAX_DATA, length - len(out))
+            out += self.call(MEM_READ, struct.pack('<IH', addr + len(out), n))
+        return bytes(out)
+
+    def mem_write(self, addr, data):
+        for off in range(0, len(data), MAX_DATA):
+            self.call(MEM_WRITE, struct.pack('<I', addr + off) + data[off:off + MAX_DATA])
+
+    def mem_crc(self, addr, length):
+        return struct.unpack('<H', self.call(MEM_CRC, struct.pack('<II', addr, length), timeout=10)[:2])[0]
+
+    def sect_read(self, lba, count):
+        out = bytearray()
+        while count:
+            n = min(count, MAX_DATA // 512)
+            out += self.call(SECT_READ, struct.pack('<IB', lba, n), timeout=5)
+            lba += n
+            count -= n
+        return bytes(out)
+
+    def sect_write(self, lba, data):
+        data += b'\0' * (-len(data) % 512)
+        for off in range(0, len(data), MAX_DATA):
+            self.call(SECT_WRITE, struct.pack('<I', lba + off // 512) + data[off:off + MAX_DATA], timeout=5)
+
+    def put(self, remote, data):
+        self.call(FILE_OPEN, b'\1' + remote.encode() + b'\0', timeout=5)
+        for off in range(0, len(data), MAX_DATA):
+            self.call(FILE_WRITE, data[off:off + MAX_DATA], timeout=5)
+        self.call(FILE_CLOSE, timeout=5)
+
+    def get(self, remote):
+        size = struct.unpack('<I', self.call(FILE_OPEN, b'\0' + remote.encode() + b'\0', timeout=5))[0]
+        out = bytearray()
+        while len(out) < size:
+            chunk = self.call(FILE_READ, struct.pack('<H', MAX_DATA), timeout=5)
+            if not chunk:
+                break
+            out += chunk
+        self.call(FILE_CLOSE)
+        return bytes(out)
+
+    def jump(self, addr):
+        """Run code at 'addr', copying its output to stdout until it returns."""
+        out = sys.stdout.buffer
+
+        def junk(b):
+            out.write(b)
+            out.flush()
+
+        # Output can arrive right behind the first reply, so read it all
+        # through frames() with junk() rather than with call()
+        self.seq = (self.seq + 1) & 0xFF
+        payload = struct.pack('<I', addr)
+        started = False
+        for _ in range(5):
+            self.send(JUMP, payload)
+            while True:
+                for frame in self.frames(3600 if started else 2.0, junk):
+                    if frame[0] != JUMP | 0x80 or frame[1] != self.seq:
+                        continue
+                    if frame[2] == RETURNED:
+                        self.in_frame = True
+                        return
+                    if frame[2] != OK:
+                        raise LinkError(STATUS.get(frame[2], 'status %d' % frame[2]))
+                    started = True
+                    self.in_frame = False
+                if not started:
+                    break
+        raise LinkError('no reply to opcode 0x%02x' % JUMP)
+
+
+def hexdump(addr, data):
+    for off in range(0, len(data), 16):
+        row = data[off:off + 16]
+        text = ''.join(chr(b) if 32 <= b < 127 else '.' for b in row)
+        print('%08X  %-48s %s' % (addr + off, ' '.join('%02X' % b for b in row), text))
+
+
+def main():
+    ap = argparse.ArgumentParser(description='PicoMon binary host link client',
+                                 usage='hostlink.py [-p port] [-b baud] [--exec cmd] action [args]')
+    ap.add_argument('-p', '--port', default=os.environ.get('PICOMON_PORT', '/dev/ttyUSB0'))
+    ap.add_argument('-b', '--baud', type=int, default=115200)
+    ap.add_argument('--exec', dest='cmd', help='talk to a command instead of a port')
+    ap.add_argument('action')
+    ap.add_argument('args', nargs='*')
+    opt = ap.parse_args()
+
+    def num(s):
+        return int(s, 0)
+
+    def read_file(name):
+        with open(name, 'rb') as f:
+            return f.read()
+
+    def write_file(name, data):
+        with open(name, 'wb') as f:
+            f.write(data)
+
+    a = opt.args
+    link = Link(Port(opt.port, opt.baud, opt.cmd))
+    try:
+        version, max_data = link.enter()
+        t0 = time.time()
+        n = 0
+        if opt.action == 'ping':
+            print('PicoMon host link v%d, %d bytes per frame' % (version, max_data))
+        elif opt.action == 'read':
+            data = link.mem_read(num(a[0]), num(a[1]))
+            n = len(data)
+            if len(a) > 2:
+                write_file(a[2], data)
+            else:
+                hexdump(num(a[0]), data)
+        elif opt.action == 'write':
+            data = read_file(a[1])
+            n = len(data)
+            link.mem_write(num(a[0]), data)
+            if link.mem_crc(num(a[0]), n) != crc16(data):
+                raise LinkError('verify failed')
+        elif opt.action == 'crc':
+            print('%04X' % link.mem_crc(num(a[0]), num(a[1])))
+        elif opt.action == 'sread':
+            data = link.sect_read(num(a[0]), num(a[1]))
+            n = len(data)
+            write_file(a[2], data)
+        elif opt.action == 'swrite':
+            data = read_file(a[1])
+            n = len(data)
+            link.sect_write(num(a[0]), data)
+        elif opt.action == 'put':
+            data = read_file(a[0])
+            n = len(data)
+            link.put(a[1] if len(a) > 1 else os.path.basename(a[0]), data)
+        elif opt.action == 'get':
+            data = link.get(a[0])
+            n = len(data)
+            write_file(a[1] if len(a) > 1 else os.path.basename(a[0]), data)
+        elif opt.action == 'run':
+            addr = num(a[1]) if len(a) > 1 else USER_PROG_ADDR
+            data = read_file(a[0])
+            link.mem_write(addr, data)
+            if link.mem_crc(addr, len(data)) != crc16(data):
+                raise LinkError('verify failed')
+            link.jump(addr)
+        elif opt.action == 'jump':
+            link.jump(num(a[0]))
+        elif opt.action == 'exit':
+            link.call(EXIT)
+        else:
+            ap.error('unknown action %r' % opt.action)
+        if n:
+            dt = time.time() - t0
+            print('%d bytes in %.2fs (%d B/s)' % (n, dt, n / dt if dt else 0), file=sys.stderr)
+    except (LinkError, IndexError, ValueError, OSError) as e:
+        sys.exit('hostlink: %s' % (e or 'missing argument'))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""Pack a flat app binary into a PicoMon LZ4 image (.lzb).
+
+Layout (little-endian):
+    0   'LZ4P'          magic, checked by the kernel loader
+    4   load address    where the image is decompressed to (and entered)
+    8   size            decompressed size in bytes
+    12  LZ4 block data  standard LZ4 block format (no frame header)
+
+Usage: lz4pack.py input.bin output.lzb [load_addr]
+"""
+import struct
+import sys
+
+MIN_MATCH = 4
+MAX_OFFSET = 0xFFFF
+LAST_LITERALS = 5      # LZ4: the last 5 bytes are always literals
+MF_LIMIT = 12          # LZ4: no match may start in the last 12 bytes
+
+
+def put_length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def emit(out, data, lit_start, lit_end, offset=0, mlen=0):
+    lit = lit_end - lit_start
+    token = (min(lit, 15) << 4) | (min(mlen - MIN_MATCH, 15) if mlen else 0)
+    out.append(token)
+    if lit >= 15:
+        put_length(out, lit - 15)
+    out += data[lit_start:lit_end]
+    if mlen:
+        out += struct.pack('<H', offset)
+        if mlen - MIN_MATCH >= 15:
+            put_length(out, mlen - MIN_MATCH - 15)
+
+
+def compress(data):
+    out = bytearray()
+    table = {}
+    n = len(data)
+    anchor = 0
+    i = 0
+    limit = n - MF_LIMIT
+    while i < limit:
+        key = data[i:i + MIN_MATCH]
+        cand = table.get(key)
+        table[key] = i
+        if cand is None or i - cand > MAX_OFFSET:
+            i += 1
+            continue
+        # Extend the match, stopping before the mandatory literal tail
+        mlen = MIN_MATCH
+        end = n - LAST_LITERALS
+        while i + mlen < end and data[cand + mlen] == data[i + mlen]:
+            mlen += 1
+        emit(out, data, anchor, i, i - cand, mlen)
+        for j in range(i + 1, min(i + mlen, limit)):
+            table[data[j:j + MIN_MATCH]] = j
+        i += mlen
+        anchor = i
+    emit(out, data, anchor, n)
+    return bytes(out)
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        sys.exit(__doc__.strip().splitlines()[-1])
+    load_addr = int(sys.argv[3], 0) if len(sys.argv) == 4 else 0x10008000
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+    packed = compress(data)
+    with open(sys.argv[2], 'wb') as f:
+        f.write(b'LZ4P' + struct.pack('<II', load_addr, len(data)) + packed)
+    print('%s: %d -> %d bytes' % (sys.argv[2], len(data), len(packed) + 12))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,129 @@
+#include "uart.h"
+#include "soc.h"
+
+#define UART_DATA   (*(volatile uint32_t*)0x20000000)
+#define UART_STATUS (*(volatile uint32_t*)0x20000004)
+#define RX_READY    0x01
+#define TX_BUSY     0x02
+
+// Rings: the IRQ handler is the only writer of rx_head, the kernel the only
+// writer of rx_tail and tx_head; tx_tail is shared with tx_start(), which
+// masks IRQs. Everything else needs no locking.
+// Indices run freely and are masked on access; sizes must be powers of two.
+// The rings themselves live in .kbuf; only the indices need to start at zero.
+#define RX_RING_SIZE 256
+#define TX_RING_SIZE 1024
+
+static volatile uint8_t rx_ring[RX_RING_SIZE] KBUF;
+static volatile uint32_t rx_head;
+static volatile uint32_t rx_tail;
+volatile uint32_t uart_rx_overruns;
+uint32_t uart_tx_bytes;
+
+static volatile uint8_t tx_ring[TX_RING_SIZE] KBUF;
+static volatile uint32_t tx_head;
+static volatile uint32_t tx_tail;
+
+void uart_irq(void) {
+    while (UART_STATUS & RX_READY) {
+        uint8_t c = UART_DATA;
+        if (rx_head - rx_tail < RX_RING_SIZE) {
+            rx_ring[rx_head & (RX_RING_SIZE - 1)] = c;
+            rx_head++;
+        } else {
+            uart_rx_overruns++;
+        }
+    }
+
+    if (tx_tail != tx_head && !(UART_STATUS & TX_BUSY)) {
+        UART_DATA = tx_ring[tx_tail & (TX_RING_SIZE - 1)];
+        tx_tail++;
+    }
+}
+
+void uart_init(void) {
+    rx_head = rx_tail = 0;
+    tx_head = tx_tail = 0;
+    irq_setmask(IRQ_ENABLED_MASK);
+}
+
+static int rx_empty(void) { return rx_head == rx_tail; }
+static int tx_full(void)  { return tx_head - tx_tail == TX_RING_SIZE; }
+static int tx_busy(void)  { return tx_head != tx_tail; }
+
+// Sleep until 'blocked' clears. IRQs are masked around the check so an
+// interrupt arriving in between still wakes waitirq; unmasking then runs
+// the handler.
+static void uart_idle(int (*blocked)(void)) {
+    uint32_t old = irq_setmask(~0u);
+    if (blocked()) irq_wait();
+    irq_setmask(old);
+}
+
+// IRQ_UART_TX only fires when a byte finishes, so once the ring has run dry
+// nothing will restart the UART: send the first byte by hand. IRQs are
+// masked so the handler cannot send from the ring at the same time.
+static void tx_start(void) {
+    uint32_t old = irq_setmask(~0u);
+    if (tx_tail != tx_head && !(UART_STATUS & TX_BUSY)) {
+        UART_DATA = tx_ring[tx_tail & (TX_RING_SIZE - 1)];
+        tx_tail++;
+    }
+    irq_setmask(old);
+}
+
+// Queue bytes for the TX interrupt. Only waits when the ring is full.
+void uart_write(const char *buf, uint32_t len) {
+    uart_tx_bytes += len;
+    while (len) {
+        while (tx_full()) uart_idle(tx_full);
+
+        uint32_t room = TX_RING_SIZE - (tx_head - tx_tail);
+        uint32_t head = tx_head;
+        if (room > len) room = len;
+        len -= room;
+        while (room--) {
+            tx_ring[head & (TX_RING_SIZE - 1)] = *buf++;
+            head++;
+        }
+        tx_head = head;
+        tx_start();
+    }
+}
+
+// Block until everything queued has been handed to the UART
+void uart_flush(void) {
+    while (tx_busy()) uart_idle(tx_busy);
+}
+
+void putc(char c) {
+    uart_write(&c, 1);
+}
+
+// Non-blocking check for character
+int has_char() {
+    return !rx_empty();
+}
+
+char getc() {
+    while (rx_empty()) uart_idle(rx_empty);
+    char c = rx_ring[rx_tail & (RX_RING_SIZE - 1)];
+    rx_tail++;
+    return c;
+}
+
+// Busy-waits on the cycle counter: there is no timer IRQ to sleep on
+int getc_timeout(uint32_t ms) {
+    uint32_t start = rdcycle();
+    uint32_t limit = ms * (CPU_HZ / 1000);
+    while (rx_empty()) {
+        if (rdcycle() - start >= limit) return -1;
+    }
+    return (uint8_t)getc();
+}
+
+void print(const char *str) {
+    const char *p = str;
+    while (*p) p++;
+    uart_write(str, p - str);
+}
@@ -0,0 +1,36 @@
+#ifndef UART_H
+#define UART_H
+
+#include <stdint.h>
+
+// Start interrupt-driven receive. Call once before the first getc().
+void uart_init(void);
+
+// Blocking character I/O (also exported to apps through the jump table)
+void putc(char c);
+char getc(void);
+void print(const char *str);
+
+// Queue 'len' bytes for interrupt-driven transmit (jump table: write).
+// Returns as soon as everything fits in the TX ring.
+void uart_write(const char *buf, uint32_t len);
+
+// Wait until all queued output has been sent
+void uart_flush(void);
+
+// Non-zero if getc() would not block
+int has_char(void);
+
+// getc() that gives up after 'ms' milliseconds: the byte, or -1
+int getc_timeout(uint32_t ms);
+
+// UART interrupt service, called from irq_handler()
+void uart_irq(void);
+
+// Characters dropped because the RX ring was full
+extern volatile uint32_t uart_rx_overruns;
+
+// Bytes queued by uart_write() since boot
+extern uint32_t uart_tx_bytes;
+
+#endif
@@ -0,0 +1,225 @@
+#include "ymodem.h"
+#include "uart.h"
+
+#define SOH  0x01   // 128-byte block
+#define STX  0x02   // 1024-byte block
+#define EOT  0x04
+#define ACK  0x06
+#define NAK  0x15
+#define CAN  0x18
+
+#define START_POLLS   60    // 'C' once a second for a minute
+#define MAX_ERRORS    10    // Consecutive bad blocks or timeouts
+#define BYTE_TIMEOUT  1000  // ms between bytes inside a block
+#define BLOCK_TIMEOUT 10000 // ms for the next block to start
+
+static const uint16_t crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
+uint16_t crc16_update(uint16_t crc, const uint8_t *buf, uint32_t len) {
+    while (len--) crc = (crc << 8) ^ crc16_table[((crc >> 8) ^ *buf++) & 0xFF];
+    return crc;
+}
+
+static uint8_t block[1024];
+
+static void cancel(void) {
+    putc(CAN); putc(CAN); putc(CAN);
+    uart_flush();
+}
+
+// Drop whatever is left of a bad block: wait until the line is quiet
+static void purge(void) {
+    while (getc_timeout(100) >= 0);
+}
+
+// Read the rest of a packet after its SOH/STX. Returns the payload length
+// with the block number in *blk, or -1 for a timeout or a bad CRC.
+static int read_packet(int start, uint8_t *blk) {
+    int len = start == STX ? 1024 : 128;
+
+    int n = getc_timeout(BYTE_TIMEOUT);
+    int inv = getc_timeout(BYTE_TIMEOUT);
+    if (n < 0 || inv < 0 || (n ^ inv) != 0xFF) return -1;
+
+    for (int i = 0; i < len; i++) {
+        int c = getc_timeout(BYTE_TIMEOUT);
+        if (c < 0) return -1;
+        block[i] = c;
+    }
+
+    int hi = getc_timeout(BYTE_TIMEOUT);
+    int lo = getc_timeout(BYTE_TIMEOUT);
+    if (hi < 0 || lo < 0) return -1;
+    if (crc16_update(0, block, len) != ((hi << 8) | lo)) return -1;
+
+    *blk = n;
+    return len;
+}
+
+// Block 0: "name\0size ..." (size in decimal, optional)
+static uint32_t header_size(const uint8_t *p) {
+    while (*p) p++;
+    p++;
+    uint32_t size = 0;
+    while (*p >= '0' && *p <= '9') size = (size << 3) + (size << 1) + (*p++ - '0');
+    return size;
+}
+
+int ymodem_receive(const YmodemSink *sink, uint32_t *received) {
+    int errors = 0;
+    int eots = 0;
+    int started = 0;        // Header (or first XMODEM block) accepted
+    int xmodem = 0;         // No header: the transfer ends at EOT
+    int batch_end = 0;      // File done, waiting for the empty header
+    uint8_t expect = 0;     // Next block number
+    uint32_t size = 0;      // From the header; 0 = unknown
+    uint32_t got = 0;
+    uint32_t blocks = 0;    // Data blocks accepted
+
+    *received = 0;
+    putc('C');
+
+    while (1) {
+        int c = getc_timeout(started ? BLOCK_TIMEOUT : 1000);
+
+        if (c < 0) {
+            if (++errors > (started ? MAX_ERRORS : START_POLLS)) {
+                cancel();
+                return YM_TIMEOUT;
+            }
+            putc(started && !batch_end ? NAK : 'C');
+            continue;
+        }
+
+        if (c == CAN) {
+            if (getc_timeout(BYTE_TIMEOUT) == CAN) return YM_CANCELED;
+            continue;
+        }
+
+        if (c == EOT && started && !batch_end) {
+            // NAK the first EOT; a real one is sent again
+            if (++eots < 2) {
+                putc(NAK);
+                continue;
+            }
+            putc(ACK);
+            *received = got;
+            if (xmodem) return YM_OK;
+            batch_end = 1;
+            errors = 0;
+            putc('C');
+            continue;
+        }
+
+        if (c != SOH && c != STX) continue; // Line noise
+
+        uint8_t blk;
+        int len = read_packet(c, &blk);
+        if (len < 0) {
+            purge();
+            if (++errors > MAX_ERRORS) {
+                cancel();
+                return YM_ERRORS;
+            }
+            putc(started && !batch_end ? NAK : 'C');
+            continue;
+        }
+        errors = 0;
+
+        if (batch_end) {
+            // The end-of-batch header, or a second file we do not take
+            putc(ACK);
+            if (block[0]) cancel();
+            return YM_OK;
+        }
+
+        if (!started) {
+            if (blk == 0) {
+                if (!block[0]) { // Empty batch
+                    putc(ACK);
+                    return YM_CANCELED;
+                }
+                // Senders may include a path; keep the file name only
+                const char *name = (const char *)block;
+                for (const char *p = name; *p; p++) if (*p == '/') name = p + 1;
+                size = header_size(block);
+                if (sink->begin(sink->ctx, name, size) != 0) {
+                    cancel();
+                    return YM_SINK;
+                }
+                started = 1;
+                expect = 1;
+                putc(ACK);
+                putc('C');
+                continue;
+            }
+            if (blk != 1) {
+                putc(NAK);
+                continue;
+            }
+            // XMODEM: data right away, no name or size
+            if (sink->begin(sink->ctx, 0, 0) != 0) {
+                cancel();
+                return YM_SINK;
+            }
+            started = 1;
+            xmodem = 1;
+            expect = 1;
+        }
+
+        if (blk == (uint8_t)(expect - 1)) { // Repeat: our ACK was lost
+            putc(ACK);
+            if (blocks == 0 && !xmodem) putc('C'); // It was the header
+            continue;
+        }
+        if (blk != expect) {
+            cancel();
+            return YM_ERRORS;
+        }
+
+        uint32_t n = len;
+        if (size) n = got >= size ? 0 : (size - got < n ? size - got : n);
+        if (n && sink->data(sink->ctx, block, n) != 0) {
+            cancel();
+            return YM_SINK;
+        }
+        got += n;
+        blocks++;
+        expect++;
+        eots = 0;
+        putc(ACK);
+    }
+}
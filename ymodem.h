@@ -0,0 +1,34 @@
+#ifndef YMODEM_H
+#define YMODEM_H
+
+#include <stdint.h>
+
+// YMODEM-1K / XMODEM-CRC receiver over the console UART.
+// The receiver polls with 'C' (CRC mode) until the sender starts. A YMODEM
+// header (block 0: name, size) is passed to begin(); a plain XMODEM sender
+// starts at block 1 and begin() gets a null name and size 0. Data blocks
+// (128 or 1024 bytes) go to data() in order, trimmed to the header size when
+// the sender gave one. Only the first file of a batch is taken.
+
+typedef struct {
+    // Header received. size is 0 if unknown. Non-zero return cancels.
+    int (*begin)(void *ctx, const char *name, uint32_t size);
+    // Next payload bytes. Non-zero return cancels.
+    int (*data)(void *ctx, const uint8_t *buf, uint32_t len);
+    void *ctx;
+} YmodemSink;
+
+#define YM_OK         0
+#define YM_CANCELED  -1     // Sender canceled, or sent no file
+#define YM_TIMEOUT   -2     // Sender never started or went silent
+#define YM_ERRORS    -3     // Too many bad blocks, or lost sync
+#define YM_SINK      -4     // begin()/data() refused
+
+// Run one transfer. Returns YM_OK or one of the errors above; on success
+// *received holds the number of bytes passed to data().
+int ymodem_receive(const YmodemSink *sink, uint32_t *received);
+
+// CRC-16/XMODEM (poly 0x1021, init 0), table driven
+uint16_t crc16_update(uint16_t crc, const uint8_t *buf, uint32_t len);
+
+#endif